@@ -0,0 +1,55 @@
+#pragma once
+
+#ifndef LEOR_BENCH_H
+#define LEOR_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "Input/SourceBuffer.h"
+
+namespace leor::bench
+{
+
+  // The source to measure on: the file named on the command line, or else
+  // tests/loadsofhello.leor repeated to about size bytes
+  inline std::string Input(int argc, char** argv, size_t size = 64 << 20)
+  {
+    if (argc > 1)
+    {
+      return std::string(SourceBuffer::FromFile(argv[1]).view());
+    }
+    auto unit = SourceBuffer::FromFile("tests/loadsofhello.leor");
+    std::string source;
+    source.reserve(size + unit.size());
+    while (source.size() < size)
+    {
+      source.append(unit.view());
+    }
+    return source;
+  }
+
+  // Best wall time of a few runs of f, in seconds
+  template <typename F>
+  double Best(F&& f, size_t runs = 5)
+  {
+    double best = 1e30;
+    for (size_t i = 0; i < runs; i++)
+    {
+      auto start = std::chrono::steady_clock::now();
+      f();
+      best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+  }
+
+  inline void Report(const char* what, size_t bytes, double seconds)
+  {
+    std::printf("  %-40s %9.1f MB/s\n", what, bytes / seconds / 1e6);
+  }
+
+} // namespace leor::bench
+
+#endif //LEOR_BENCH_H
@@ -0,0 +1,33 @@
+#include <cstdio>
+
+#include "Bench.h"
+#include "Lexer/TokenStream.h"
+
+// Lexing throughput, token by token and into a TokenStream
+int32_t main(int argc, char** argv)
+{
+  auto source = leor::bench::Input(argc, argv);
+  std::printf("Lexing %.1f MB\n", source.size() / 1e6);
+
+  size_t count = 0;
+  auto get = leor::bench::Best([&]
+  {
+    leor::Lexer lexer(source);
+    count = 0;
+    while (!lexer.eof())
+    {
+      lexer.get();
+      count++;
+    }
+  });
+  leor::bench::Report("Lexer::get", source.size(), get);
+
+  auto tokenize = leor::bench::Best([&]
+  {
+    auto tokens = leor::TokenStream::Tokenize(source);
+  });
+  leor::bench::Report("TokenStream::Tokenize", source.size(), tokenize);
+
+  std::printf("  %zu tokens\n", count);
+  return 0;
+}
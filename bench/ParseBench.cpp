@@ -0,0 +1,50 @@
+#include <cstdio>
+#include <string>
+
+#include "Bench.h"
+#include "Parser/Parser.h"
+
+// Parsing throughput over tokens lexed up front, so that only the parser is measured
+// It needs nothing but Tokenize and an eager Parser, so the same program can be built
+// in a checkout of an earlier tree to compare the parser before and after a change.
+namespace
+{
+
+  using namespace leor;
+
+  // Statement repeated to about size bytes
+  std::string Repeat(std::string_view statement, size_t size)
+  {
+    std::string source;
+    source.reserve(size + statement.size());
+    while (source.size() < size)
+    {
+      source.append(statement);
+    }
+    return source;
+  }
+
+  void Measure(const char* what, const std::string& source)
+  {
+    auto tokens = TokenStream::Tokenize(source);
+    auto seconds = bench::Best([&]
+    {
+      Parser parser(tokens);
+      auto ast = parser();
+    });
+    bench::Report(what, source.size(), seconds);
+  }
+
+} // namespace
+
+int32_t main(int argc, char** argv)
+{
+  constexpr size_t SIZE = 16 << 20;
+  auto source = bench::Input(argc, argv, SIZE);
+  std::printf("Parsing %.1f MB\n", source.size() / 1e6);
+
+  Measure(argc > 1 ? argv[1] : "tests/loadsofhello.leor", source);
+  Measure("Assignments and binary operators", Repeat("x = a * b + c - d / e == f && g;\n", SIZE));
+  Measure("Nested calls", Repeat("f(g(a, h(b, c)), i(j(k(d))), e);\n", SIZE));
+  return 0;
+}
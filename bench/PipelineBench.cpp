@@ -0,0 +1,62 @@
+#include <cstdio>
+#include <thread>
+
+#include "Bench.h"
+#include "Parser/Parser.h"
+
+// Throughput of the TokenQueue alone, and of parsing with the lexer on a thread of its
+// own against lexing everything up front
+int32_t main(int argc, char** argv)
+{
+  using namespace leor;
+
+  auto source = bench::Input(argc, argv, 16 << 20);
+  std::printf("Pipelining %.1f MB\n", source.size() / 1e6);
+
+  // The tokens of the source, handed from one thread to another and nothing else
+  constexpr size_t BATCH = 256;
+  auto tokens = TokenStream::Tokenize(source);
+  auto queue = bench::Best([&]
+  {
+    TokenQueue queue;
+    std::thread producer([&]
+    {
+      for (size_t i = 0; i < tokens.size(); i++)
+      {
+        queue.push(tokens[i]);
+      }
+      queue.flush();
+    });
+    Token batch[BATCH];
+    for (size_t popped = 0; popped < tokens.size();)
+    {
+      popped += queue.pop(batch, BATCH);
+    }
+    producer.join();
+  });
+  std::printf("  %-40s %9.1f Mtokens/s\n", "TokenQueue", tokens.size() / queue / 1e6);
+
+  auto lex = bench::Best([&]
+  {
+    Lexer lexer(source);
+    while (!lexer.get().isEOB())
+    { }
+  });
+  bench::Report("Lexer::get", source.size(), lex);
+
+  auto upfront = bench::Best([&]
+  {
+    auto tokens = TokenStream::Tokenize(source);
+    Parser parser(tokens);
+    auto ast = parser();
+  });
+  bench::Report("Tokenize, then parse", source.size(), upfront);
+
+  auto pipelined = bench::Best([&]
+  {
+    Parser parser(source, Parser::Pipelined{});
+    auto ast = parser();
+  });
+  bench::Report("Parser::Pipelined", source.size(), pipelined);
+  return 0;
+}
@@ -0,0 +1,51 @@
+#include "Diagnostics/Diagnostics.h"
+
+namespace leor
+{
+
+  std::string_view Diagnostic::Message(DiagCode code)
+  {
+    switch (code)
+    {
+      case DiagCode::UNEXPECTED_CHARACTER: return "Unexpected character '{}'";
+      case DiagCode::UNKNOWN_ESCAPE:       return "Unknown escape sequence '\\{}'";
+      case DiagCode::MALFORMED_ESCAPE:     return "Malformed escape sequence '\\{}'";
+      case DiagCode::UNTERMINATED_STRING:  return "Missing terminating {} character";
+      case DiagCode::EMPTY_CHARACTER:      return "Empty character literal";
+      case DiagCode::MULTIPLE_CHARACTERS:  return "Character literal '{}' holds more than one character";
+      case DiagCode::INVALID_NUMBER:       return "Invalid numeric literal '{}'";
+      case DiagCode::NUMBER_OUT_OF_RANGE:  return "Numeric literal '{}' is out of range";
+      case DiagCode::EXPECTED_PUNC:        return "Expected punctuation: {}";
+      case DiagCode::EXPECTED_OP:          return "Expected operator: {}";
+      case DiagCode::EXPECTED_KEYWORD:     return "Expected keyword: {}";
+      case DiagCode::EXPECTED_VARNAME:     return "Expected variable name";
+      case DiagCode::UNEXPECTED_TOKEN:     return "Unexpected token '{}'";
+      case DiagCode::NESTING_TOO_DEEP:     return "Nesting exceeds the limit of {} levels";
+      case DiagCode::TREE_TOO_LARGE:       return "The syntax tree outgrows its {} region: parse the file with ParseEach, or split it";
+    }
+    return "Unknown error";
+  }
+
+  std::string Diagnostic::toString() const
+  {
+    auto message = Message(code);
+    auto hole = message.find("{}");
+
+    std::string result = std::to_string(lineCol.row) + ":" + std::to_string(lineCol.col) + ":Error: ";
+    if (hole == std::string_view::npos)
+    {
+      result += message;
+    }
+    else
+    {
+      result.append(message.substr(0, hole)).append(arg).append(message.substr(hole + 2));
+    }
+    return result;
+  }
+
+  void Diagnostics::report(Diagnostic diag)
+  {
+    m_diags.push_back(std::move(diag));
+  }
+
+} // namespace leor
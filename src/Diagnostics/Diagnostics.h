@@ -0,0 +1,70 @@
+#pragma once
+
+#ifndef LEOR_DIAGNOSTICS_H
+#define LEOR_DIAGNOSTICS_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Input/SourceManager.h"
+
+namespace leor
+{
+
+  // Enum DiagCode - Every problem the lexer and parser can report
+  enum class DiagCode : uint8_t
+  {
+    UNEXPECTED_CHARACTER,
+    UNKNOWN_ESCAPE,
+    MALFORMED_ESCAPE,
+    UNTERMINATED_STRING,
+    EMPTY_CHARACTER,
+    MULTIPLE_CHARACTERS,
+    INVALID_NUMBER,
+    NUMBER_OUT_OF_RANGE,
+    EXPECTED_PUNC,
+    EXPECTED_OP,
+    EXPECTED_KEYWORD,
+    EXPECTED_VARNAME,
+    UNEXPECTED_TOKEN,
+    NESTING_TOO_DEEP,
+    TREE_TOO_LARGE
+  };
+
+  // Struct Diagnostic - A reported problem, formatted only when it's printed
+  // The row and column are resolved when reporting, since the text of a streamed
+  // source may be gone by the time the diagnostic is printed.
+  struct Diagnostic
+  {
+    DiagCode code;
+    SourceLoc loc;
+    LineCol lineCol;
+    std::string arg; // Fills the {} of the code's message
+
+    // Message template of a code
+    static std::string_view Message(DiagCode code);
+
+    std::string toString() const;
+  };
+
+  // Class Diagnostics - Collects the diagnostics of a compilation without unwinding
+  // The lexer and parser report into it and carry on, so one pass finds every error.
+  class Diagnostics
+  {
+  private:
+    std::vector<Diagnostic> m_diags;
+
+  public:
+    void report(Diagnostic diag);
+
+    const std::vector<Diagnostic>& all() const { return m_diags; }
+    size_t size() const { return m_diags.size(); }
+    bool empty() const { return m_diags.empty(); }
+    void clear() { m_diags.clear(); }
+  };
+
+} // namespace leor
+
+#endif // LEOR_DIAGNOSTICS_H
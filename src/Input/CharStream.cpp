@@ -1,38 +1,89 @@
 #include "Input/CharStream.h"
 
+#include <algorithm>
+#include <stdexcept>
+
 namespace leor
 {
 
-  CharStream::CharStream(const std::string& buffer)
-    : m_buffer(buffer), m_row(0), m_col(0), m_it(0)
+  CharStream::CharStream(std::string_view buffer)
+    : m_buffer(buffer), m_it(0), m_base(0), m_ring(nullptr), m_lines(buffer)
+  {
+    if (buffer.size() > UINT32_MAX)
+    {
+      throw std::runtime_error("Error: Source exceeds the 4 GiB size limit");
+    }
+  }
+
+  CharStream::CharStream(PageRing& ring)
+    : m_buffer(), m_it(0), m_base(0), m_ring(&ring), m_lines(std::string_view())
   { }
 
+  bool CharStream::refill()
+  {
+    if (m_ring == nullptr)
+    {
+      return false;
+    }
+    auto page = m_ring->next();
+    if (page.empty())
+    {
+      return false;
+    }
+    m_base += m_buffer.size();
+    m_buffer = page;
+    m_it = 0;
+    return true;
+  }
+
   int8_t CharStream::peek()
   {
-    return m_buffer[m_it];
+    return eof() ? '\0' : m_buffer[m_it];
   }
 
   int8_t CharStream::get()
   {
-    int8_t c = m_buffer[m_it];
-    if (c == '\n') {
-      m_col = 0;
-      m_row++;
-    } else {
-      m_col++;
-    }
-    m_it++;
-    return c;
+    return eof() ? '\0' : m_buffer[m_it++];
   }
 
   bool CharStream::eof()
   {
-    return m_it >= m_buffer.size();
+    return m_it >= m_buffer.size() && !refill();
+  }
+
+  std::string_view CharStream::span()
+  {
+    return eof() ? std::string_view() : m_buffer.substr(m_it);
+  }
+
+  void CharStream::advance(size_t n)
+  {
+    m_it += n;
+  }
+
+  void CharStream::seek(StreamPos pos)
+  {
+    if (m_ring != nullptr)
+    {
+      throw std::logic_error("CharStream::seek: streamed sources can't seek");
+    }
+    m_it = std::min<uint64_t>(pos, m_buffer.size());
   }
 
   CharStream::StreamPos CharStream::getPos()
   {
-    return std::make_tuple(m_row, m_col);
+    return static_cast<StreamPos>(m_base + m_it);
+  }
+
+  LineCol CharStream::lineCol(StreamPos pos) const
+  {
+    if (m_ring != nullptr)
+    {
+      // Resolve relative to the current position so wrapped offsets still work
+      uint64_t current = m_base + m_it;
+      return m_ring->lineCol(current - static_cast<StreamPos>(static_cast<StreamPos>(current) - pos));
+    }
+    return m_lines.lineCol(pos);
   }
 
-}
\ No newline at end of file
+}
@@ -3,26 +3,37 @@
 #ifndef LEOR_CHARSTREAM_H
 #define LEOR_CHARSTREAM_H
 
-#include <string>
-#include <tuple>
+#include <cstdint>
+#include <string_view>
+
+#include "Input/PageRing.h"
+#include "Input/SourceManager.h"
 
 namespace leor
 {
 
-  // Class CharStream - A simple stream of characters with row and column tracking
+  // Class CharStream - A simple stream of characters with byte offset tracking
+  // The stream either borrows a whole buffer, which must outlive it, or pulls
+  // pages from a PageRing as it runs out of characters.
   class CharStream
   {
   public:
-    using StreamPos = std::tuple<uint64_t, uint64_t>;
+    using StreamPos = uint32_t;
   private:
-    std::string m_buffer;
-    uint64_t m_row, m_col;
+    std::string_view m_buffer; // The whole source, or the current page
     uint64_t m_it;
+    uint64_t m_base;           // Offset of m_buffer in the source
+    PageRing* m_ring;
+    LineTable m_lines;
+
+    // Move on to the next page of the ring, if any
+    bool refill();
 
   public:
-    CharStream(const std::string& buffer);
+    CharStream(std::string_view buffer);
+    CharStream(PageRing& ring);
 
-    // Peek the current character without advancing the stream
+    // Peek the current character without advancing the stream, '\0' at EOF
     int8_t peek();
 
     // Get the current character and advance the stream
@@ -31,10 +42,27 @@ namespace leor
     // EOF check
     bool eof();
 
-    // Get the current row and column
+    // Characters available without refilling, starting at the current one; empty at EOF
+    std::string_view span();
+
+    // Advance the stream by n characters of the current span
+    void advance(size_t n);
+
+    // Jump to a byte offset of a whole-buffer stream
+    void seek(StreamPos pos);
+
+    // Check if views into spans stay valid for the lifetime of the stream,
+    // which is not the case for pages of a PageRing
+    bool stable() const { return m_ring == nullptr; }
+
+    // Get the current byte offset
+    // Offsets of streamed sources wrap around after 4 GiB.
     StreamPos getPos();
+
+    // Resolve a byte offset into a row and column
+    LineCol lineCol(StreamPos pos) const;
   };
 
 } // namespace leor
 
-#endif //LEOR_CHARSTREAM_H
\ No newline at end of file
+#endif //LEOR_CHARSTREAM_H
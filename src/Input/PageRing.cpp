@@ -0,0 +1,85 @@
+#include "Input/PageRing.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <unistd.h>
+
+namespace leor
+{
+
+  PageRing::PageRing(int fd, size_t pageSize, size_t pages)
+    : m_fd(fd), m_pageSize(pageSize), m_count(std::max<size_t>(pages, 2)),
+      m_memory(new char[m_pageSize * m_count]), m_pages(new Page[m_count]),
+      m_filled(0), m_offset(0), m_row(0), m_lineStart(0), m_eof(false)
+  { }
+
+  std::string_view PageRing::next()
+  {
+    if (m_eof)
+    {
+      return std::string_view();
+    }
+
+    size_t slot = m_filled % m_count;
+    char* data = m_memory.get() + slot * m_pageSize;
+    ssize_t n;
+    do
+    {
+      // A single read keeps pipes and terminals responsive: short pages are fine
+      n = read(m_fd, data, m_pageSize);
+    } while (n < 0 && errno == EINTR);
+
+    if (n < 0)
+    {
+      throw std::runtime_error(std::string("Error: Cannot read source: ") + std::strerror(errno));
+    }
+    if (n == 0)
+    {
+      m_eof = true;
+      return std::string_view();
+    }
+
+    m_pages[slot] = Page{ m_offset, m_row, m_lineStart, static_cast<size_t>(n) };
+    m_row += std::count(data, data + n, '\n');
+    if (auto last = static_cast<const char*>(memrchr(data, '\n', n)))
+    {
+      m_lineStart = m_offset + (last - data) + 1;
+    }
+    m_offset += n;
+    m_filled++;
+    return std::string_view(data, n);
+  }
+
+  LineCol PageRing::lineCol(uint64_t offset) const
+  {
+    uint64_t resident = std::min<uint64_t>(m_filled, m_count);
+    for (uint64_t i = 1; i <= resident; i++)
+    {
+      size_t slot = (m_filled - i) % m_count;
+      const Page& page = m_pages[slot];
+      if (offset < page.base || offset > page.base + page.size)
+      {
+        continue;
+      }
+
+      const char* data = m_memory.get() + slot * m_pageSize;
+      uint64_t row = page.row;
+      uint64_t lineStart = page.lineStart;
+      for (uint64_t j = page.base; j < offset; j++)
+      {
+        if (data[j - page.base] == '\n')
+        {
+          row++;
+          lineStart = j + 1;
+        }
+      }
+      return LineCol{ row, offset - lineStart };
+    }
+    return LineCol{ 0, offset };
+  }
+
+} // namespace leor
@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef LEOR_PAGERING_H
+#define LEOR_PAGERING_H
+
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#include "Input/SourceManager.h"
+
+namespace leor
+{
+
+  // Class PageRing - A fixed-size ring of pages refilled from a file descriptor
+  // Memory stays at pageSize * pages no matter how long the input is. The pages
+  // before the current one stay resident until the ring wraps around, so recent
+  // positions can still be resolved for diagnostics.
+  class PageRing
+  {
+  public:
+    static constexpr size_t DEFAULT_PAGE_SIZE = 64 * 1024;
+    static constexpr size_t DEFAULT_PAGES = 4;
+
+  private:
+    struct Page
+    {
+      uint64_t base;      // Offset of the first byte in the source
+      uint64_t row;       // Newlines before the first byte
+      uint64_t lineStart; // Offset of the line containing the first byte
+      size_t size;
+    };
+
+    int m_fd;
+    size_t m_pageSize;
+    size_t m_count;
+    std::unique_ptr<char[]> m_memory;
+    std::unique_ptr<Page[]> m_pages;
+    uint64_t m_filled; // Number of pages filled so far
+    uint64_t m_offset, m_row, m_lineStart;
+    bool m_eof;
+
+  public:
+    // The descriptor is borrowed and must stay open while the ring is in use
+    explicit PageRing(int fd, size_t pageSize = DEFAULT_PAGE_SIZE, size_t pages = DEFAULT_PAGES);
+
+    PageRing(const PageRing&) = delete;
+    PageRing& operator=(const PageRing&) = delete;
+
+    // Read the next page, overwriting the oldest one; empty at EOF
+    std::string_view next();
+
+    // Resolve an offset that is still resident into a row and column
+    // Offsets that were already recycled resolve to row 0 and their byte offset.
+    LineCol lineCol(uint64_t offset) const;
+  };
+
+} // namespace leor
+
+#endif //LEOR_PAGERING_H
@@ -0,0 +1,155 @@
+#include "Input/SourceBuffer.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace leor
+{
+
+  SourceBuffer::SourceBuffer()
+    : m_data(""), m_size(0), m_mapped(false)
+  { }
+
+  SourceBuffer::SourceBuffer(SourceBuffer&& other) noexcept
+    : m_data(other.m_data), m_size(other.m_size), m_mapped(other.m_mapped), m_owned(std::move(other.m_owned))
+  {
+    other.m_data = "";
+    other.m_size = 0;
+    other.m_mapped = false;
+  }
+
+  SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) noexcept
+  {
+    if (this != &other)
+    {
+      release();
+      m_data = other.m_data;
+      m_size = other.m_size;
+      m_mapped = other.m_mapped;
+      m_owned = std::move(other.m_owned);
+      other.m_data = "";
+      other.m_size = 0;
+      other.m_mapped = false;
+    }
+    return *this;
+  }
+
+  SourceBuffer::~SourceBuffer()
+  {
+    release();
+  }
+
+  void SourceBuffer::release()
+  {
+    if (m_mapped)
+    {
+      munmap(const_cast<char*>(m_data), m_size);
+    }
+    m_owned.reset();
+    m_data = "";
+    m_size = 0;
+    m_mapped = false;
+  }
+
+  SourceBuffer SourceBuffer::FromFile(const std::string& path)
+  {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+      throw std::runtime_error("Error: Cannot open '" + path + "': " + std::strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+      void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr != MAP_FAILED)
+      {
+        close(fd);
+        madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+        SourceBuffer result;
+        result.m_data = static_cast<const char*>(addr);
+        result.m_size = st.st_size;
+        result.m_mapped = true;
+        return result;
+      }
+    }
+
+    // Pipes, character devices and filesystems without mmap support
+    try
+    {
+      auto result = FromDescriptor(fd);
+      close(fd);
+      return result;
+    }
+    catch (...)
+    {
+      close(fd);
+      throw;
+    }
+  }
+
+  SourceBuffer SourceBuffer::FromDescriptor(int fd)
+  {
+    size_t capacity = 1 << 16;
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+      capacity = st.st_size + 1;
+    }
+
+    std::unique_ptr<char[]> buffer(new char[capacity]);
+    size_t size = 0;
+    while (true)
+    {
+      if (size == capacity)
+      {
+        std::unique_ptr<char[]> grown(new char[capacity * 2]);
+        std::memcpy(grown.get(), buffer.get(), size);
+        buffer = std::move(grown);
+        capacity *= 2;
+      }
+      ssize_t n = read(fd, buffer.get() + size, capacity - size);
+      if (n < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        throw std::runtime_error(std::string("Error: Cannot read source: ") + std::strerror(errno));
+      }
+      if (n == 0)
+      {
+        break;
+      }
+      size += n;
+    }
+
+    SourceBuffer result;
+    result.m_owned = std::move(buffer);
+    result.m_data = result.m_owned.get();
+    result.m_size = size;
+    return result;
+  }
+
+  SourceBuffer SourceBuffer::FromString(std::string_view str)
+  {
+    SourceBuffer result;
+    if (!str.empty())
+    {
+      result.m_owned.reset(new char[str.size()]);
+      std::memcpy(result.m_owned.get(), str.data(), str.size());
+      result.m_data = result.m_owned.get();
+      result.m_size = str.size();
+    }
+    return result;
+  }
+
+} // namespace leor
@@ -0,0 +1,56 @@
+#pragma once
+
+#ifndef LEOR_SOURCEBUFFER_H
+#define LEOR_SOURCEBUFFER_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace leor
+{
+
+  // Class SourceBuffer - Read-only contents of a source file
+  // Files are memory-mapped when possible and read into an owned buffer otherwise,
+  // so the contents are loaded once and only ever borrowed as a std::string_view.
+  class SourceBuffer
+  {
+  private:
+    const char* m_data;
+    size_t m_size;
+    bool m_mapped;
+    std::unique_ptr<char[]> m_owned;
+
+    SourceBuffer();
+
+  public:
+    SourceBuffer(SourceBuffer&& other) noexcept;
+    SourceBuffer& operator=(SourceBuffer&& other) noexcept;
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+    ~SourceBuffer();
+
+    // Map the file at path, falling back to reading it when it can't be mapped
+    static SourceBuffer FromFile(const std::string& path);
+
+    // Read everything from an open file descriptor
+    static SourceBuffer FromDescriptor(int fd);
+
+    // Take a copy of an in-memory source
+    static SourceBuffer FromString(std::string_view str);
+
+    std::string_view view() const { return std::string_view(m_data, m_size); }
+    const char* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    // Check if the contents are memory-mapped
+    bool isMapped() const { return m_mapped; }
+
+  private:
+    void release();
+  };
+
+} // namespace leor
+
+#endif //LEOR_SOURCEBUFFER_H
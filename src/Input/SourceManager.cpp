@@ -0,0 +1,89 @@
+#include "Input/SourceManager.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace leor
+{
+
+  LineTable::LineTable(std::string_view buffer)
+    : m_buffer(buffer)
+  { }
+
+  void LineTable::build() const
+  {
+    const char* data = m_buffer.data();
+    size_t size = m_buffer.size();
+    size_t i = 0;
+
+    m_starts.reserve(size / 32 + 1);
+    m_starts.push_back(0);
+#if defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16)
+    {
+      auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+      uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, newline));
+      while (mask)
+      {
+        m_starts.push_back(i + __builtin_ctz(mask) + 1);
+        mask &= mask - 1;
+      }
+    }
+#endif
+    for (; i < size; i++)
+    {
+      if (data[i] == '\n')
+      {
+        m_starts.push_back(i + 1);
+      }
+    }
+  }
+
+  LineCol LineTable::lineCol(uint32_t offset) const
+  {
+    if (m_starts.empty())
+    {
+      build();
+    }
+    auto it = std::upper_bound(m_starts.begin(), m_starts.end(), offset);
+    uint64_t row = (it - m_starts.begin()) - 1;
+    return LineCol{ row, offset - m_starts[row] };
+  }
+
+  FileID SourceManager::open(const std::string& path)
+  {
+    return add(path, SourceBuffer::FromFile(path));
+  }
+
+  FileID SourceManager::add(const std::string& name, SourceBuffer buffer)
+  {
+    if (buffer.size() > UINT32_MAX)
+    {
+      throw std::runtime_error("Error: '" + name + "' exceeds the 4 GiB source size limit");
+    }
+    auto view = buffer.view();
+    m_files.push_back(std::unique_ptr<File>(new File{ name, std::move(buffer), LineTable(view) }));
+    return m_files.size() - 1;
+  }
+
+  std::string_view SourceManager::buffer(FileID file) const
+  {
+    return m_files.at(file)->buffer.view();
+  }
+
+  const std::string& SourceManager::name(FileID file) const
+  {
+    return m_files.at(file)->name;
+  }
+
+  LineCol SourceManager::lineCol(SourceLoc loc) const
+  {
+    return m_files.at(loc.file)->lines.lineCol(loc.offset);
+  }
+
+} // namespace leor
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef LEOR_SOURCEMANAGER_H
+#define LEOR_SOURCEMANAGER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Input/SourceBuffer.h"
+
+namespace leor
+{
+  using FileID = uint32_t;
+
+  // Struct SourceLoc - A byte offset into a file known to the SourceManager
+  struct SourceLoc
+  {
+    uint32_t offset = 0;
+    FileID file = 0;
+  };
+
+  // Struct LineCol - A zero-based row and column, only computed on demand
+  struct LineCol
+  {
+    uint64_t row;
+    uint64_t col;
+  };
+
+  // Class LineTable - Offsets of line starts in a buffer, built on first use
+  class LineTable
+  {
+  private:
+    std::string_view m_buffer;
+    mutable std::vector<uint32_t> m_starts;
+
+  public:
+    explicit LineTable(std::string_view buffer);
+
+    // Translate a byte offset into a row and column
+    LineCol lineCol(uint32_t offset) const;
+
+  private:
+    void build() const;
+  };
+
+  // Class SourceManager - Owns the source files of a compilation and resolves their locations
+  class SourceManager
+  {
+  private:
+    struct File
+    {
+      std::string name;
+      SourceBuffer buffer;
+      LineTable lines;
+    };
+    std::vector<std::unique_ptr<File>> m_files;
+
+  public:
+    // Map the file at path and register it
+    FileID open(const std::string& path);
+
+    // Register an already loaded buffer
+    FileID add(const std::string& name, SourceBuffer buffer);
+
+    std::string_view buffer(FileID file) const;
+    const std::string& name(FileID file) const;
+
+    // Translate a location into a row and column
+    LineCol lineCol(SourceLoc loc) const;
+  };
+
+} // namespace leor
+
+#endif //LEOR_SOURCEMANAGER_H
@@ -0,0 +1,129 @@
+#pragma once
+
+#ifndef LEOR_CHARCLASS_H
+#define LEOR_CHARCLASS_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+#include "Lexer/Grammar.h"
+
+namespace leor
+{
+
+  // Build the 256-entry table of CharClass flags at compile time
+  constexpr std::array<uint8_t, 256> MakeCharClassTable();
+  // Build the 256-entry table of what each character starts at compile time
+  constexpr std::array<uint8_t, 256> MakeStartTable();
+
+  // Class CharClass - Character classification through a 256-entry lookup table
+  class CharClass
+  {
+  private:
+    CharClass() { }
+  public:
+    enum Flag : uint8_t
+    {
+      WHITESPACE = 1 << 0,
+      COMMENT    = 1 << 1,
+      ID_START   = 1 << 2,
+      ID         = 1 << 3,
+      DIGIT      = 1 << 4,
+      OP         = 1 << 5,
+      PUNC       = 1 << 6,
+      QUOTE      = 1 << 7,
+    };
+
+    // What a token starting with a character is, or what to skip
+    enum Start : uint8_t
+    {
+      INVALID,
+      SKIP_WHITESPACE, SKIP_COMMENT,
+      NUMBER, IDENTIFIER, STRING, CHAR,
+      SYMBOL,
+    };
+
+    static const std::array<uint8_t, 256> TABLE;
+    static const std::array<uint8_t, 256> STARTS;
+
+    static constexpr bool is(int8_t c, uint8_t flags)
+    {
+      return (TABLE[static_cast<uint8_t>(c)] & flags) != 0;
+    }
+
+    static constexpr Start start(int8_t c)
+    {
+      return static_cast<Start>(STARTS[static_cast<uint8_t>(c)]);
+    }
+  };
+
+  constexpr std::array<uint8_t, 256> MakeCharClassTable()
+  {
+    std::array<uint8_t, 256> table{};
+    auto add = [&table](std::string_view chars, uint8_t flags)
+    {
+      for (char c : chars)
+      {
+        table[static_cast<uint8_t>(c)] |= flags;
+      }
+    };
+
+    add(" \t\n\v\f\r", CharClass::WHITESPACE);
+    add("#", CharClass::COMMENT);
+    add("abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_", CharClass::ID_START | CharClass::ID);
+    add("0123456789", CharClass::DIGIT | CharClass::ID);
+    for (auto& symbol : Grammar::SYMBOLS)
+    {
+      add(symbol.text, symbol.kind == SymbolKind::OP ? CharClass::OP : CharClass::PUNC);
+    }
+    add("\"'", CharClass::QUOTE);
+    return table;
+  }
+
+  inline constexpr std::array<uint8_t, 256> CharClass::TABLE = MakeCharClassTable();
+
+  constexpr std::array<uint8_t, 256> MakeStartTable()
+  {
+    std::array<uint8_t, 256> table{};
+    for (size_t i = 0; i < table.size(); i++)
+    {
+      auto c = static_cast<int8_t>(i);
+      auto& start = table[i];
+      if (CharClass::is(c, CharClass::WHITESPACE))
+      {
+        start = CharClass::SKIP_WHITESPACE;
+      }
+      else if (CharClass::is(c, CharClass::COMMENT))
+      {
+        start = CharClass::SKIP_COMMENT;
+      }
+      else if (CharClass::is(c, CharClass::DIGIT))
+      {
+        start = CharClass::NUMBER;
+      }
+      else if (CharClass::is(c, CharClass::ID_START))
+      {
+        start = CharClass::IDENTIFIER;
+      }
+      else if (c == '\"')
+      {
+        start = CharClass::STRING;
+      }
+      else if (c == '\'')
+      {
+        start = CharClass::CHAR;
+      }
+      else if (Grammar::DFA.step(Grammar::DFA.START, c) != Grammar::DFA.DEAD)
+      {
+        start = CharClass::SYMBOL;
+      }
+    }
+    return table;
+  }
+
+  inline constexpr std::array<uint8_t, 256> CharClass::STARTS = MakeStartTable();
+
+} // namespace leor
+
+#endif //LEOR_CHARCLASS_H
@@ -0,0 +1,292 @@
+#pragma once
+
+#ifndef LEOR_GRAMMAR_H
+#define LEOR_GRAMMAR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+namespace leor
+{
+
+  // Kinds of tokens with a fixed spelling
+  enum class SymbolKind : uint8_t
+  {
+    NONE,
+    OP, PUNC
+  };
+
+  // Tokens with a fixed spelling, numbered after their place in Grammar::SYMBOLS
+  enum class Op : uint8_t
+  {
+    NONE,
+    ADD, SUB, MUL, DIV, MOD, ASSIGN, NOT, LT, GT, BIT_AND, BIT_OR, BIT_XOR, COLON,
+    EQ, NE, LE, GE, AND, OR, ARROW,
+    ADD_ASSIGN, SUB_ASSIGN, MUL_ASSIGN, DIV_ASSIGN, MOD_ASSIGN,
+    LPAREN, RPAREN, LBRACKET, RBRACKET, LBRACE, RBRACE, SEMICOLON, COMMA,
+  };
+
+  // Struct SymbolSpec - A token with a fixed spelling
+  struct SymbolSpec
+  {
+    std::string_view text;
+    SymbolKind kind;
+  };
+
+  // Struct SymbolDFA - A DFA recognizing a set of symbols, built at compile time
+  // Bytes are mapped to columns first, so the table only has a column per byte that
+  // appears in some symbol, plus column 0 for every other byte.
+  template <size_t States, size_t Columns>
+  struct SymbolDFA
+  {
+    static constexpr uint8_t DEAD = 0;
+    static constexpr uint8_t START = 1;
+
+    std::array<uint8_t, 256> columns{};
+    std::array<std::array<uint8_t, Columns>, States> next{};
+    std::array<SymbolKind, States> accept{};
+    std::array<uint8_t, States> symbol{}; // Index of the symbol accepted, 0 for none
+    size_t states = 2;
+
+    constexpr uint8_t step(uint8_t state, char c) const
+    {
+      return next[state][columns[static_cast<uint8_t>(c)]];
+    }
+
+    // Length of the longest symbol text starts with, 0 if there is none
+    constexpr size_t match(std::string_view text, SymbolKind* kind = nullptr) const
+    {
+      size_t length = 0;
+      uint8_t state = START;
+      for (size_t i = 0; i < text.size(); i++)
+      {
+        state = step(state, text[i]);
+        if (state == DEAD)
+        {
+          break;
+        }
+        if (accept[state] != SymbolKind::NONE)
+        {
+          length = i + 1;
+          if (kind)
+          {
+            *kind = accept[state];
+          }
+        }
+      }
+      return length;
+    }
+  };
+
+  // Number of table columns: one per distinct byte of the symbols, plus one for the rest
+  template <const auto& Symbols>
+  constexpr size_t SymbolColumns()
+  {
+    std::array<bool, 256> seen{};
+    size_t columns = 1;
+    for (auto& symbol : Symbols)
+    {
+      for (char c : symbol.text)
+      {
+        columns += !seen[static_cast<uint8_t>(c)];
+        seen[static_cast<uint8_t>(c)] = true;
+      }
+    }
+    return columns;
+  }
+
+  // Upper bound on the states of the trie: the dead state, the start, and one per byte
+  template <const auto& Symbols>
+  constexpr size_t SymbolTrieStates()
+  {
+    size_t states = 2;
+    for (auto& symbol : Symbols)
+    {
+      states += symbol.text.size();
+    }
+    return states;
+  }
+
+  // The trie of the symbols, which is a DFA already, though not a minimal one
+  // Every state is numbered after its parent. Symbols[0] stands for no symbol, so
+  // accepting states can tell which symbol they accept by its index.
+  template <const auto& Symbols>
+  constexpr auto SymbolTrie()
+  {
+    static_assert(Symbols[0].text.empty() && Symbols[0].kind == SymbolKind::NONE, "Symbols[0] must be a placeholder");
+
+    SymbolDFA<SymbolTrieStates<Symbols>(), SymbolColumns<Symbols>()> trie;
+    uint8_t column = 1;
+    for (size_t i = 1; i < Symbols.size(); i++)
+    {
+      auto& symbol = Symbols[i];
+      uint8_t state = trie.START;
+      for (char c : symbol.text)
+      {
+        auto& col = trie.columns[static_cast<uint8_t>(c)];
+        if (col == 0)
+        {
+          col = column++;
+        }
+        auto& next = trie.next[state][col];
+        if (next == trie.DEAD)
+        {
+          next = static_cast<uint8_t>(trie.states++);
+        }
+        state = next;
+      }
+      trie.accept[state] = symbol.kind;
+      trie.symbol[state] = static_cast<uint8_t>(i);
+    }
+    return trie;
+  }
+
+  // Number every state of the trie after the class of states it's equivalent to
+  // States are equivalent when they accept the same symbol and go to equivalent states.
+  // Children are numbered after their parents, so walking backwards settles them first.
+  template <const auto& Symbols>
+  constexpr auto SymbolStateClasses()
+  {
+    constexpr auto trie = SymbolTrie<Symbols>();
+    std::array<size_t, trie.next.size()> rep{};
+    for (size_t s = trie.states; s-- > trie.START;)
+    {
+      rep[s] = s;
+      for (size_t t = s + 1; t < trie.states; t++)
+      {
+        bool same = rep[t] == t && trie.symbol[s] == trie.symbol[t];
+        for (size_t c = 0; same && c < trie.next[s].size(); c++)
+        {
+          same = rep[trie.next[s][c]] == rep[trie.next[t][c]];
+        }
+        if (same)
+        {
+          rep[s] = t;
+          break;
+        }
+      }
+    }
+
+    std::array<uint8_t, trie.next.size()> classes{};
+    uint8_t count = trie.START;
+    for (size_t s = trie.START; s < trie.states; s++)
+    {
+      if (rep[s] == s)
+      {
+        classes[s] = count++;
+      }
+    }
+    for (size_t s = trie.START; s < trie.states; s++)
+    {
+      classes[s] = classes[rep[s]];
+    }
+    return std::make_pair(classes, static_cast<size_t>(count));
+  }
+
+  // Build the minimal DFA recognizing the symbols at compile time
+  template <const auto& Symbols>
+  constexpr auto MakeSymbolDFA()
+  {
+    constexpr auto trie = SymbolTrie<Symbols>();
+    constexpr auto classes = SymbolStateClasses<Symbols>();
+    static_assert(classes.second <= 256, "Too many states for 8-bit transitions");
+
+    SymbolDFA<classes.second, trie.next[0].size()> dfa;
+    dfa.columns = trie.columns;
+    dfa.states = classes.second;
+    for (size_t s = trie.START; s < trie.states; s++)
+    {
+      auto state = classes.first[s];
+      dfa.accept[state] = trie.accept[s];
+      dfa.symbol[state] = trie.symbol[s];
+      for (size_t c = 0; c < trie.next[s].size(); c++)
+      {
+        dfa.next[state][c] = classes.first[trie.next[s][c]];
+      }
+    }
+    return dfa;
+  }
+
+  // Class Grammar - The tokens with a fixed spelling, declared once
+  // The lexer matches them through a minimal DFA built from this list at compile time,
+  // taking the longest match. Every other token starts with a character that CharClass
+  // routes to the scanner of its literal form.
+  class Grammar
+  {
+  private:
+    Grammar() { }
+
+  public:
+    static constexpr std::array<SymbolSpec, 34> SYMBOLS =
+    {{
+      { "",   SymbolKind::NONE },
+      { "+",  SymbolKind::OP }, { "-",  SymbolKind::OP }, { "*",  SymbolKind::OP },
+      { "/",  SymbolKind::OP }, { "%",  SymbolKind::OP }, { "=",  SymbolKind::OP },
+      { "!",  SymbolKind::OP }, { "<",  SymbolKind::OP }, { ">",  SymbolKind::OP },
+      { "&",  SymbolKind::OP }, { "|",  SymbolKind::OP }, { "^",  SymbolKind::OP },
+      { ":",  SymbolKind::OP },
+      { "==", SymbolKind::OP }, { "!=", SymbolKind::OP }, { "<=", SymbolKind::OP },
+      { ">=", SymbolKind::OP }, { "&&", SymbolKind::OP }, { "||", SymbolKind::OP },
+      { "->", SymbolKind::OP },
+      { "+=", SymbolKind::OP }, { "-=", SymbolKind::OP }, { "*=", SymbolKind::OP },
+      { "/=", SymbolKind::OP }, { "%=", SymbolKind::OP },
+      { "(",  SymbolKind::PUNC }, { ")",  SymbolKind::PUNC }, { "[",  SymbolKind::PUNC },
+      { "]",  SymbolKind::PUNC }, { "{",  SymbolKind::PUNC }, { "}",  SymbolKind::PUNC },
+      { ";",  SymbolKind::PUNC }, { ",",  SymbolKind::PUNC },
+    }};
+
+    // Spelling of a symbol
+    static constexpr std::string_view text(Op op)
+    {
+      return SYMBOLS[static_cast<size_t>(op)].text;
+    }
+
+    // The symbol spelled by text, or NONE
+    static constexpr Op find(std::string_view text)
+    {
+      for (size_t i = 1; i < SYMBOLS.size(); i++)
+      {
+        if (SYMBOLS[i].text == text)
+        {
+          return static_cast<Op>(i);
+        }
+      }
+      return Op::NONE;
+    }
+
+    // Every prefix of a symbol must be a symbol itself: then a longest match never
+    // has to give characters back, and the lexer can run the DFA across pages
+    static constexpr bool PrefixClosed()
+    {
+      for (auto& symbol : SYMBOLS)
+      {
+        for (size_t length = 1; length < symbol.text.size(); length++)
+        {
+          bool found = false;
+          for (auto& other : SYMBOLS)
+          {
+            found = found || other.text == symbol.text.substr(0, length);
+          }
+          if (!found)
+          {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+
+    static constexpr auto DFA = MakeSymbolDFA<SYMBOLS>();
+  };
+
+  static_assert(Grammar::PrefixClosed(), "Every prefix of a symbol must be a symbol");
+  static_assert(Grammar::DFA.match("=-") == 1, "Symbols are matched by longest match");
+  static_assert(Grammar::find("%=") == Op::MOD_ASSIGN && Grammar::find(",") == Op::COMMA, "Op follows Grammar::SYMBOLS");
+  static_assert(static_cast<size_t>(Op::COMMA) + 1 == Grammar::SYMBOLS.size(), "Op follows Grammar::SYMBOLS");
+
+} // namespace leor
+
+#endif //LEOR_GRAMMAR_H
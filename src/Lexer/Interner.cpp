@@ -0,0 +1,154 @@
+#include "Lexer/Interner.h"
+
+#include <stdexcept>
+
+namespace leor
+{
+
+  Interner::Interner()
+    : m_next(1), m_chunks(new std::atomic<std::string_view*>[MAX_CHUNKS])
+  {
+    for (size_t i = 0; i < MAX_CHUNKS; i++)
+    {
+      m_chunks[i].store(nullptr, std::memory_order_relaxed);
+    }
+    for (auto& shard : m_shards)
+    {
+      shard.slots.resize(64, Slot{ 0, 0 });
+    }
+    // Symbol 0 is the empty name
+    m_chunks[0].store(new std::string_view[CHUNK_SIZE], std::memory_order_release);
+  }
+
+  Interner::~Interner()
+  {
+    for (size_t i = 0; i < MAX_CHUNKS; i++)
+    {
+      delete[] m_chunks[i].load(std::memory_order_relaxed);
+    }
+  }
+
+  Interner& Interner::Global()
+  {
+    static Interner interner;
+    return interner;
+  }
+
+  uint64_t Interner::Hash(std::string_view name)
+  {
+    // FNV-1a: identifiers are short, so per-byte hashing is cheap enough
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : name)
+    {
+      hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  Symbol Interner::intern(std::string_view name)
+  {
+    struct CacheEntry
+    {
+      const char* data;
+      uint32_t size;
+      uint32_t id;
+    };
+    static thread_local std::array<CacheEntry, 1024> cache{};
+
+    auto hash = Hash(name);
+    auto& entry = cache[hash & (cache.size() - 1)];
+    if (entry.id != 0 && entry.size == name.size() && std::string_view(entry.data, entry.size) == name)
+    {
+      return Symbol{ entry.id };
+    }
+
+    auto sym = internSlow(name, hash);
+    auto stored = this->name(sym);
+    entry = CacheEntry{ stored.data(), static_cast<uint32_t>(stored.size()), sym.id };
+    return sym;
+  }
+
+  Symbol Interner::internSlow(std::string_view name, uint64_t hash)
+  {
+    auto& shard = m_shards[hash % SHARDS];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    size_t mask = shard.slots.size() - 1;
+    // The low bits chose the shard, so probe with the high ones
+    for (size_t i = (hash >> 8) & mask;; i = (i + 1) & mask)
+    {
+      auto& slot = shard.slots[i];
+      if (slot.id == 0)
+      {
+        break;
+      }
+      if (slot.hash == hash && this->name(Symbol{ slot.id }) == name)
+      {
+        return Symbol{ slot.id };
+      }
+    }
+
+    uint32_t id = m_next.fetch_add(1, std::memory_order_relaxed);
+    if ((id >> CHUNK_BITS) >= MAX_CHUNKS)
+    {
+      throw std::runtime_error("Error: Too many distinct identifiers");
+    }
+
+    auto& chunk = m_chunks[id >> CHUNK_BITS];
+    auto names = chunk.load(std::memory_order_acquire);
+    if (names == nullptr)
+    {
+      // Several shards may race to allocate the same chunk
+      auto fresh = new std::string_view[CHUNK_SIZE];
+      if (chunk.compare_exchange_strong(names, fresh, std::memory_order_acq_rel))
+      {
+        names = fresh;
+      }
+      else
+      {
+        delete[] fresh;
+      }
+    }
+    names[id & (CHUNK_SIZE - 1)] = shard.names.copy(name);
+
+    if ((shard.count + 1) * 2 > shard.slots.size())
+    {
+      grow(shard);
+      mask = shard.slots.size() - 1;
+    }
+    size_t i = (hash >> 8) & mask;
+    while (shard.slots[i].id != 0)
+    {
+      i = (i + 1) & mask;
+    }
+    shard.slots[i] = Slot{ hash, id };
+    shard.count++;
+    return Symbol{ id };
+  }
+
+  void Interner::grow(Shard& shard)
+  {
+    std::vector<Slot> slots(shard.slots.size() * 2, Slot{ 0, 0 });
+    size_t mask = slots.size() - 1;
+    for (auto& slot : shard.slots)
+    {
+      if (slot.id == 0)
+      {
+        continue;
+      }
+      size_t i = (slot.hash >> 8) & mask;
+      while (slots[i].id != 0)
+      {
+        i = (i + 1) & mask;
+      }
+      slots[i] = slot;
+    }
+    shard.slots = std::move(slots);
+  }
+
+  size_t Interner::size() const
+  {
+    return m_next.load(std::memory_order_relaxed) - 1;
+  }
+
+} // namespace leor
@@ -0,0 +1,89 @@
+#pragma once
+
+#ifndef LEOR_INTERNER_H
+#define LEOR_INTERNER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "Memory/Arena.h"
+
+namespace leor
+{
+
+  // Struct Symbol - A dense id standing for an interned identifier
+  struct Symbol
+  {
+    uint32_t id;
+
+    friend bool operator==(Symbol a, Symbol b) = default;
+  };
+
+  // Class Interner - The process-wide table of identifiers
+  // Every distinct name gets one Symbol, numbered from 1 in order of first interning.
+  // Interning is thread-safe: names are spread over independently locked shards and
+  // each thread keeps a small cache of recent lookups that needs no locking at all.
+  class Interner
+  {
+  private:
+    static constexpr size_t SHARDS = 16;
+    static constexpr size_t CHUNK_BITS = 12;
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static constexpr size_t MAX_CHUNKS = size_t(1) << 16;
+
+    struct Slot
+    {
+      uint64_t hash;
+      uint32_t id;
+    };
+
+    struct Shard
+    {
+      std::mutex mutex;
+      std::vector<Slot> slots; // Open addressing, id 0 marks an empty slot
+      size_t count = 0;
+      Arena names;
+    };
+
+    std::array<Shard, SHARDS> m_shards;
+    std::atomic<uint32_t> m_next;
+    // Names by id, in chunks that never move once allocated
+    std::unique_ptr<std::atomic<std::string_view*>[]> m_chunks;
+
+    Interner();
+
+  public:
+    Interner(const Interner&) = delete;
+    Interner& operator=(const Interner&) = delete;
+    ~Interner();
+
+    static Interner& Global();
+
+    // Get the symbol for a name, adding it if it's new
+    Symbol intern(std::string_view name);
+
+    // Name of a symbol
+    std::string_view name(Symbol sym) const
+    {
+      auto chunk = m_chunks[sym.id >> CHUNK_BITS].load(std::memory_order_acquire);
+      return chunk[sym.id & (CHUNK_SIZE - 1)];
+    }
+
+    // Number of symbols so far
+    size_t size() const;
+
+    static uint64_t Hash(std::string_view name);
+
+  private:
+    Symbol internSlow(std::string_view name, uint64_t hash);
+    void grow(Shard& shard);
+  };
+
+} // namespace leor
+
+#endif //LEOR_INTERNER_H
@@ -0,0 +1,121 @@
+#pragma once
+
+#ifndef LEOR_KEYWORD_H
+#define LEOR_KEYWORD_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+namespace leor
+{
+
+  enum class Keyword : uint8_t
+  {
+    NONE,
+    TRUE, FALSE,
+    DEF, RETURN,
+    CONST, MUT,
+  };
+
+  // Class Keywords - Keyword recognition through a perfect hash computed at compile time
+  class Keywords
+  {
+  private:
+    Keywords() { }
+
+  public:
+    static constexpr std::array<std::string_view, 7> NAMES =
+    {
+      "", "true", "false", "def", "return", "const", "mut"
+    };
+
+    static constexpr size_t TABLE_SIZE = 16;
+
+    // Name of a keyword
+    static constexpr std::string_view name(Keyword keyword)
+    {
+      return NAMES[static_cast<size_t>(keyword)];
+    }
+
+    // The keyword spelled by text, or NONE
+    static constexpr Keyword lookup(std::string_view text)
+    {
+      if (text.size() < MIN_LENGTH || text.size() > MAX_LENGTH)
+      {
+        return Keyword::NONE;
+      }
+      auto keyword = TABLE[hash(text, MULTIPLIER)];
+      return name(keyword) == text ? keyword : Keyword::NONE;
+    }
+
+  private:
+    // The multiplier packs one factor for the first character in its low byte
+    // and one for the last character in its high byte
+    static constexpr size_t hash(std::string_view text, uint32_t multiplier)
+    {
+      auto first = static_cast<uint8_t>(text.front()) * (multiplier & 0xFF);
+      auto last = static_cast<uint8_t>(text.back()) * (multiplier >> 8);
+      return (first + last + text.size()) % TABLE_SIZE;
+    }
+
+    // Smallest multiplier under which no two keywords collide, 0 if there is none
+    static constexpr uint32_t FindMultiplier()
+    {
+      for (uint32_t multiplier = 0x101; multiplier < 0x10000; multiplier++)
+      {
+        std::array<bool, TABLE_SIZE> used{};
+        bool collision = false;
+        for (size_t i = 1; i < NAMES.size() && !collision; i++)
+        {
+          auto slot = hash(NAMES[i], multiplier);
+          collision = used[slot];
+          used[slot] = true;
+        }
+        if (!collision)
+        {
+          return multiplier;
+        }
+      }
+      return 0;
+    }
+
+    static constexpr std::array<Keyword, TABLE_SIZE> MakeTable(uint32_t multiplier)
+    {
+      std::array<Keyword, TABLE_SIZE> table{};
+      for (size_t i = 1; i < NAMES.size(); i++)
+      {
+        table[hash(NAMES[i], multiplier)] = static_cast<Keyword>(i);
+      }
+      return table;
+    }
+
+    static constexpr size_t Length(bool longest)
+    {
+      size_t result = longest ? 0 : SIZE_MAX;
+      for (size_t i = 1; i < NAMES.size(); i++)
+      {
+        result = longest ? std::max(result, NAMES[i].size()) : std::min(result, NAMES[i].size());
+      }
+      return result;
+    }
+
+  public:
+    // Defined below, once the helpers above can be evaluated
+    static const uint32_t MULTIPLIER;
+    static const std::array<Keyword, TABLE_SIZE> TABLE;
+    static const size_t MIN_LENGTH;
+    static const size_t MAX_LENGTH;
+  };
+
+  inline constexpr uint32_t Keywords::MULTIPLIER = Keywords::FindMultiplier();
+  static_assert(Keywords::MULTIPLIER != 0, "No perfect hash for the keyword set, grow TABLE_SIZE");
+
+  inline constexpr std::array<Keyword, Keywords::TABLE_SIZE> Keywords::TABLE = Keywords::MakeTable(Keywords::MULTIPLIER);
+  inline constexpr size_t Keywords::MIN_LENGTH = Keywords::Length(false);
+  inline constexpr size_t Keywords::MAX_LENGTH = Keywords::Length(true);
+
+} // namespace leor
+
+#endif //LEOR_KEYWORD_H
@@ -1,18 +1,26 @@
 #include "Lexer/Lexer.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <utility>
+
 namespace leor
 {
   
+  static_assert(std::is_trivially_copyable_v<Token>, "Tokens are passed around by value");
+  static_assert(sizeof(Token) <= 32, "Tokens should stay within half a cache line");
+
   Token::Token()
-    : type(Type::NONE), value("")
+    : Token(Type::NONE, "")
   { }
 
-  Token::Token(Type type, const std::string& value)
-    : type(type), value(value), pos(std::make_tuple(0, 0))
+  Token::Token(Type type, std::string_view value, const TokenPos& pos)
+    : Token(type, value, pos, value.size())
   { }
 
-  Token::Token(Type type, const std::string& value, const TokenPos& pos)
-    : type(type), value(value), pos(pos)
+  Token::Token(Type type, std::string_view value, const TokenPos& pos, uint32_t length)
+    : text(value.data()), payload{ .text = { static_cast<uint32_t>(value.size()), 0 } }, pos(pos), length(length), type(type)
   { }
 
   const hash_map<Token::Type, std::string> Token::TypeToString =
@@ -29,9 +37,15 @@ namespace leor
     { Type::PUNC,    "PUNC" }
   };
 
-  std::string Token::toString() const
+  std::string Token::toString(const SourceManager& sources) const
+  {
+    return toString(sources.lineCol(pos));
+  }
+
+  std::string Token::toString(const LineCol& lineCol) const
   {
-    return std::string("(") + std::to_string(std::get<0>(pos)) + ", " + std::to_string(std::get<1>(pos)) + ")\t" + TypeToString.at(type) + "\t  " + value;
+    auto [row, col] = lineCol;
+    return std::string("(") + std::to_string(row) + ", " + std::to_string(col) + ")\t" + TypeToString.at(type) + "\t  " + std::string(value());
   }
 
   bool Token::isNone() const
@@ -49,89 +63,285 @@ namespace leor
     return isNone() || isEOB();
   }
 
-  const hash_map<char, char> ESCAPE_SEQUENCES =
-  {
-    { 'n', '\n' },
-    { 'r', '\r' },
-    { 't', '\t' },
-    { 'v', '\v' },
-    { 'b', '\b' },
-    { 'a', '\a' },
-    { 'f', '\f' },
-    { '\\', '\\' },
-    { '\'', '\'' },
-    { '\"', '\"' },
-    { '0', '\0' }
-  };
+  Lexer::Lexer(std::string_view buffer, FileID file, Diagnostics* diags)
+    : m_stream(buffer), m_file(file), m_current(), m_diags(diags), m_intern(true)
+  { }
 
-  Lexer::Lexer(const std::string& buffer)
-    : m_stream(buffer), m_current(Token::Type::NONE, "")
+  Lexer::Lexer(PageRing& ring, FileID file, Diagnostics* diags)
+    : m_stream(ring), m_file(file), m_current(), m_diags(diags), m_intern(true)
   { }
 
+  SourceLoc Lexer::loc()
+  {
+    return SourceLoc{ m_stream.getPos(), m_file };
+  }
+
+  void Lexer::seek(uint32_t offset)
+  {
+    m_stream.seek(offset);
+    m_current = Token();
+  }
+
+  LineCol Lexer::lineCol(const SourceLoc& loc) const
+  {
+    return m_stream.lineCol(loc.offset);
+  }
+
+  void Lexer::error(DiagCode code, const SourceLoc& loc, std::string_view arg)
+  {
+    Diagnostic diag{ code, loc, lineCol(loc), std::string(arg) };
+    if (!m_diags)
+    {
+      throw std::runtime_error(diag.toString());
+    }
+    m_diags->report(std::move(diag));
+  }
+
   void Lexer::skipWhitespace()
   {
-    rdWhile(isWHITESPACE);
+    skipRun(Scan::whitespace);
   }
 
   void Lexer::skipComment()
   {
-    rdWhile([](int8_t c) { return c != '\n'; });
+    skipRun(Scan::line);
+  }
+
+  std::string_view Lexer::keep(std::string_view text)
+  {
+    return m_stream.stable() ? text : m_arena.copy(text);
+  }
+
+  std::string_view Lexer::rdRun(Scan::Kernel scan)
+  {
+    return rdSpan(scan);
   }
 
-  std::string Lexer::rdWhile(const std::function<bool(int8_t)>& pred)
+  void Lexer::skipRun(Scan::Kernel scan)
   {
-    std::string result;
-    while (!m_stream.eof() && pred(m_stream.peek()))
+    for (auto span = m_stream.span(); !span.empty(); span = m_stream.span())
     {
-      result += m_stream.get();
+      auto end = span.data() + span.size();
+      auto stop = scan(span.data(), end);
+      m_stream.advance(stop - span.data());
+      if (stop != end)
+      {
+        break;
+      }
     }
-    return result;
   }
 
-  std::string Lexer::rdWhile(const std::function<bool(const std::string&)>& pred)
+  std::string_view Lexer::rdEsc(const char& end, bool* closed)
   {
-    std::string result;
-    while (!m_stream.eof() && pred(std::string(1, m_stream.peek())))
+    auto start = loc();
+    m_stream.get();
+
+    // Find the closing quote in one pass, stepping over escaped characters
+    auto span = m_stream.span();
+    auto begin = span.data();
+    auto limit = begin + span.size();
+    bool escaped = false;
+    auto stop = Scan::quoted(begin, limit, end);
+    while (stop != limit && *stop == '\\')
     {
-      result += m_stream.get();
+      escaped = true;
+      stop = stop + 2 < limit ? Scan::quoted(stop + 2, limit, end) : limit;
     }
-    return result;
+    if (stop != limit)
+    {
+      m_stream.advance(stop - begin + 1);
+      std::string_view raw(begin, stop - begin);
+      return escaped ? unescape(raw, start) : keep(raw);
+    }
+
+    // The literal continues on the next page of a streamed source, or is unterminated
+    auto& raw = m_scratch;
+    raw.clear();
+    bool terminated = false;
+    size_t skip = 0; // An escaped character continuing on the next page
+    for (; !span.empty(); span = m_stream.span())
+    {
+      begin = span.data();
+      limit = begin + span.size();
+      stop = Scan::quoted(begin + std::min(skip, span.size()), limit, end);
+      skip = 0;
+      while (stop != limit && *stop == '\\')
+      {
+        if (stop + 2 > limit)
+        {
+          skip = 1;
+          stop = limit;
+          break;
+        }
+        stop = Scan::quoted(stop + 2, limit, end);
+      }
+      raw.append(begin, stop);
+      terminated = stop != limit;
+      m_stream.advance(stop - begin + terminated);
+      if (terminated)
+      {
+        break;
+      }
+    }
+    if (!terminated)
+    {
+      error(DiagCode::UNTERMINATED_STRING, start, std::string(1, end));
+      if (closed)
+      {
+        *closed = false;
+      }
+    }
+    return unescape(raw, start);
   }
 
-  std::string Lexer::rdEsc(const char& end)
+  static int HexDigit(char c)
   {
-    std::string result;
-    m_stream.get();
-    char c = m_stream.get();
-    bool esc = false;
-    while (!m_stream.eof() && c != end)
+    if (c >= '0' && c <= '9')
+    {
+      return c - '0';
+    }
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+    {
+      return (c | 0x20) - 'a' + 10;
+    }
+    return -1;
+  }
+
+  std::string_view Lexer::unescape(std::string_view raw, const SourceLoc& start)
+  {
+    // An escape never decodes to more bytes than it takes in the source,
+    // so the text fits in a buffer as large as the raw one
+    auto result = static_cast<char*>(m_arena.allocate(raw.size(), 1));
+    auto out = result;
+    auto it = raw.data();
+    auto last = it + raw.size();
+    while (it != last)
     {
-      if (esc)
+      // Copy everything up to the next escape at once
+      auto slash = static_cast<const char*>(std::memchr(it, '\\', last - it));
+      slash = slash ? slash : last;
+      std::memcpy(out, it, slash - it);
+      out += slash - it;
+      it = slash;
+      if (it == last || it + 1 == last)
       {
-        result += ESCAPE_SEQUENCES.at(c);
-        esc = false;
+        // A backslash ending an unterminated literal escapes nothing
+        break;
       }
-      else if (c == '\\')
+
+      auto at = SourceLoc{ static_cast<uint32_t>(start.offset + 1 + (it - raw.data())), start.file };
+      auto decoded = Escapes::decode(it[1]);
+      if (decoded >= 0)
       {
-        esc = true;
+        *out++ = static_cast<char>(decoded);
+        it += 2;
+        continue;
       }
-      else
+      if (decoded == Escapes::UNKNOWN)
+      {
+        // Keep the character as it is
+        error(DiagCode::UNKNOWN_ESCAPE, at, std::string(1, it[1]));
+        *out++ = it[1];
+        it += 2;
+        continue;
+      }
+
+      auto digits = it + 2;
+      uint32_t value = 0;
+      bool valid = false;
+      auto stop = digits;
+      if (decoded == Escapes::HEX)
       {
-        result += c;
+        // Exactly two hex digits
+        for (; stop != last && stop != digits + 2 && HexDigit(*stop) >= 0; stop++)
+        {
+          value = value * 16 + HexDigit(*stop);
+        }
+        valid = stop == digits + 2;
+        if (valid)
+        {
+          *out++ = static_cast<char>(value);
+        }
       }
-      c = m_stream.get();
+      else if (digits != last && *digits == '{')
+      {
+        // One to six hex digits naming a Unicode scalar value
+        for (stop = digits + 1; stop != last && stop != digits + 7 && HexDigit(*stop) >= 0; stop++)
+        {
+          value = value * 16 + HexDigit(*stop);
+        }
+        valid = stop != digits + 1 && stop != last && *stop == '}'
+          && value <= 0x10FFFF && (value < 0xD800 || value > 0xDFFF);
+        if (valid)
+        {
+          stop++;
+          if (value < 0x80)
+          {
+            *out++ = static_cast<char>(value);
+          }
+          else if (value < 0x800)
+          {
+            *out++ = static_cast<char>(0xC0 | (value >> 6));
+            *out++ = static_cast<char>(0x80 | (value & 0x3F));
+          }
+          else if (value < 0x10000)
+          {
+            *out++ = static_cast<char>(0xE0 | (value >> 12));
+            *out++ = static_cast<char>(0x80 | ((value >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (value & 0x3F));
+          }
+          else
+          {
+            *out++ = static_cast<char>(0xF0 | (value >> 18));
+            *out++ = static_cast<char>(0x80 | ((value >> 12) & 0x3F));
+            *out++ = static_cast<char>(0x80 | ((value >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (value & 0x3F));
+          }
+        }
+      }
+      if (!valid)
+      {
+        // Drop the backslash and letter, leaving what follows as plain text
+        error(DiagCode::MALFORMED_ESCAPE, at, std::string(it + 1, stop));
+        stop = digits;
+      }
+      it = stop;
     }
-    return result;
+    m_arena.shrink(out);
+    return std::string_view(result, out - result);
   }
 
   Token Lexer::rdNumber()
   {
-    auto pos = m_stream.getPos();
+    auto pos = loc();
 
-    std::string result;
+    int8_t first = m_stream.peek();
+    size_t n = 0;
+    int base = 10;
     bool dot = false;
-    auto f = [&dot](int8_t c) -> bool
+    auto f = [&](int8_t c) -> bool
     {
+      if (n++ == 0)
+      {
+        return true;
+      }
+      if (n == 2 && first == '0' && (c == 'x' || c == 'X' || c == 'b' || c == 'B'))
+      {
+        base = (c == 'x' || c == 'X') ? 16 : 2;
+        return true;
+      }
+      if (c == '_')
+      {
+        return true;
+      }
+      if (base == 16)
+      {
+        return CharClass::is(c, CharClass::DIGIT) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+      }
+      if (base == 2)
+      {
+        return c == '0' || c == '1';
+      }
       if (c == '.') {
         if (dot) {
           return false;
@@ -139,105 +349,193 @@ namespace leor
         dot = true;
         return true;
       }
-      return std::regex_match(std::string(1, c), RegExs::DIGIT);
+      return CharClass::is(c, CharClass::DIGIT);
     };
-    std::string num = rdWhile(f);
-    return Token
+    auto num = rdWhile(f);
+    Token tok
     (
       dot ? Token::Type::FLOAT : Token::Type::INT,
       num,
       pos
     );
+
+    // from_chars takes neither prefixes nor separators
+    auto digits = base == 10 ? num : num.substr(2);
+    if (digits.find('_') != std::string_view::npos)
+    {
+      m_scratch.clear();
+      std::copy_if(digits.begin(), digits.end(), std::back_inserter(m_scratch), [](char c) { return c != '_'; });
+      digits = m_scratch;
+    }
+    auto begin = digits.data();
+    auto end = begin + digits.size();
+
+    std::from_chars_result result;
+    if (dot)
+    {
+      tok.payload.real = 0;
+      result = std::from_chars(begin, end, tok.payload.real);
+    }
+    else if (base == 10)
+    {
+      tok.payload.integer = 0;
+      result = std::from_chars(begin, end, tok.payload.integer);
+    }
+    else
+    {
+      // Hex and binary literals spell out bits, so they may use the sign bit
+      uint64_t bits = 0;
+      result = std::from_chars(begin, end, bits, base);
+      tok.payload.integer = static_cast<int64_t>(bits);
+    }
+
+    if (result.ec == std::errc::result_out_of_range)
+    {
+      error(DiagCode::NUMBER_OUT_OF_RANGE, pos, num);
+    }
+    else if (result.ec != std::errc() || result.ptr != end)
+    {
+      error(DiagCode::INVALID_NUMBER, pos, num);
+    }
+    return tok;
   }
 
   Token Lexer::rdID()
   {
-    auto pos = m_stream.getPos();
+    auto pos = loc();
 
-    std::string result = rdWhile(isID);
+    auto result = rdRun(Scan::id);
 
-    return Token
-    (
-      std::regex_match(result, RegExs::KEYWORD) ? Token::Type::KEYWORD : Token::Type::VAR,
-      result,
-      pos
-    );
+    auto keyword = Keywords::lookup(result);
+    Token tok(keyword != Keyword::NONE ? Token::Type::KEYWORD : Token::Type::VAR, result, pos);
+    if (keyword != Keyword::NONE)
+    {
+      tok.payload.keyword = keyword;
+    }
+    else
+    {
+      tok.payload.symbol = m_intern ? Interner::Global().intern(result) : Symbol{ 0 };
+    }
+    return tok;
   }
 
   Token Lexer::rdString()
   {
-    auto pos = m_stream.getPos();
+    auto pos = loc();
 
-    std::string result = rdEsc('\"');
+    auto result = rdEsc('\"');
 
     return Token
     (
       Token::Type::STRING,
       result,
-      pos
+      pos,
+      m_stream.getPos() - pos.offset
     );
   }
 
   Token Lexer::rdChar()
   {
-    auto pos = m_stream.getPos();
+    auto pos = loc();
 
-    std::string result = rdEsc('\'');
+    bool closed = true;
+    auto result = rdEsc('\'', &closed);
+    if (closed && DecodeChar(result) == INVALID_CHAR)
+    {
+      // The token keeps what was written, and the parser makes do with it
+      if (result.empty())
+      {
+        error(DiagCode::EMPTY_CHARACTER, pos);
+      }
+      else
+      {
+        error(DiagCode::MULTIPLE_CHARACTERS, pos, result);
+      }
+    }
 
     return Token
     (
       Token::Type::CHAR,
       result,
-      pos
+      pos,
+      m_stream.getPos() - pos.offset
     );
   }
 
-  Token Lexer::rdNext()
+  Token Lexer::rdSymbol()
   {
-    skipWhitespace();
-    if (std::regex_match(std::string(1, m_stream.peek()), RegExs::COMMENT))
-    {
-      skipComment();
-      return rdNext();
-    }
-    if (m_stream.eof())
-    {
-      return Token(Token::Type::EOB, "", m_stream.getPos());
-    }
-    auto c = m_stream.peek();
-    auto sc = std::string(1, c);
+    auto pos = loc();
 
-    if (std::regex_match(sc, RegExs::DIGIT))
+    // Symbols are prefix closed: as long as the DFA is alive it has a match
+    uint8_t state = Grammar::DFA.START;
+    auto text = rdSpan([&state](const char* begin, const char* end)
     {
-      return rdNumber();
-    }
-    if (std::regex_match(sc, RegExs::ID))
-    {
-      return rdID();
-    }
-    if (c == '\"')
-    {
-      return rdString();
-    }
-    if (c == '\'')
-    {
-      return rdChar();
-    }
-    if (std::regex_match(sc, RegExs::OP))
-    {
-      auto pos = m_stream.getPos();
-      return Token(Token::Type::OP, rdWhile(isOP), pos);
-    }
-    if (std::regex_match(sc, RegExs::PUNC))
+      for (; begin != end; begin++)
+      {
+        auto next = Grammar::DFA.step(state, *begin);
+        if (next == Grammar::DFA.DEAD)
+        {
+          break;
+        }
+        state = next;
+      }
+      return begin;
+    });
+    auto kind = Grammar::DFA.accept[state];
+    Token tok(kind == SymbolKind::OP ? Token::Type::OP : Token::Type::PUNC, text, pos);
+    tok.payload.op = static_cast<Op>(Grammar::DFA.symbol[state]);
+    return tok;
+  }
+
+  Token Lexer::rdNext()
+  {
+    while (true)
     {
-      auto pos = m_stream.getPos();
-      m_stream.get();
-      return Token(Token::Type::PUNC, sc, pos);
+      auto c = m_stream.peek();
+      switch (CharClass::start(c))
+      {
+        case CharClass::SKIP_WHITESPACE:
+          skipWhitespace();
+          continue;
+        case CharClass::SKIP_COMMENT:
+          skipComment();
+          continue;
+        case CharClass::NUMBER:
+          return rdNumber();
+        case CharClass::IDENTIFIER:
+          return rdID();
+        case CharClass::STRING:
+          return rdString();
+        case CharClass::CHAR:
+          return rdChar();
+        case CharClass::SYMBOL:
+          return rdSymbol();
+        case CharClass::INVALID:
+          break;
+      }
+
+      if (m_stream.eof())
+      {
+        return Token(Token::Type::EOB, "", loc());
+      }
+
+      // Report a run of characters that can't start a token once, then lex past it
+      error(DiagCode::UNEXPECTED_CHARACTER, loc(), std::string(1, c));
+      rdWhile([](int8_t c)
+      {
+        return CharClass::start(c) == CharClass::INVALID;
+      });
     }
-    auto pos = m_stream.getPos();
-    std::stringstream err;
-    err << std::get<0>(pos) << ":" << std::get<1>(pos) << ":Error: Unexpected character '" << sc << "'";
-    throw std::runtime_error(err.str());
+  }
+
+  Arena Lexer::takeArena()
+  {
+    return std::move(m_arena);
+  }
+
+  void Lexer::swapArena(Arena& other)
+  {
+    std::swap(m_arena, other);
   }
 
   Token Lexer::peek()
@@ -6,8 +6,15 @@
 #include <functional>
 #include <unordered_map>
 
+#include "Diagnostics/Diagnostics.h"
 #include "Input/CharStream.h"
-#include "Lexer/RegExs.h"
+#include "Input/SourceManager.h"
+#include "Lexer/CharClass.h"
+#include "Lexer/Grammar.h"
+#include "Lexer/Interner.h"
+#include "Lexer/Keyword.h"
+#include "Lexer/Scan.h"
+#include "Memory/Arena.h"
 
 
 namespace leor
@@ -19,10 +26,12 @@ namespace leor
   using hash_map = std::unordered_map<_Key, _Tp, _Hash, _Pred, _Alloc>;
   
   // Struct Token - A token with a type and value
+  // Tokens are trivially copyable: the value is a view into the source buffer, or
+  // into the lexer's arena for text that had to be decoded or copied out of a stream.
   struct Token
   {
-    using TokenPos = CharStream::StreamPos;
-    enum class Type
+    using TokenPos = SourceLoc;
+    enum class Type : uint8_t
     {
       NONE, EOB,
       INT, FLOAT, STRING, CHAR,
@@ -31,15 +40,43 @@ namespace leor
     };
     static const hash_map<Type, std::string> TypeToString;
 
-    Type type;
-    std::string value;
+    // Decoded literal values
+    union Payload
+    {
+      // STRING, CHAR: size of the decoded text, and where a TokenStream keeps it
+      // (1 + index into its decoded strings, or 0 for the source between the quotes)
+      struct
+      {
+        uint32_t size;
+        uint32_t decoded;
+      } text;
+      int64_t integer; // INT
+      double real;     // FLOAT
+      Symbol symbol;   // VAR
+      Keyword keyword; // KEYWORD
+      Op op;           // OP, PUNC
+    };
+
+    const char* text;
+    Payload payload;
     TokenPos pos;
+    uint32_t length; // Length of the token in the source
+    Type type;
 
     Token();
-    Token(Type type, const std::string& value);
-    Token(Type type, const std::string& value, const TokenPos& pos);
+    Token(Type type, std::string_view value, const TokenPos& pos = TokenPos());
+    Token(Type type, std::string_view value, const TokenPos& pos, uint32_t length);
 
-    std::string toString() const;
+    // The token's text, decoded for strings and chars
+    std::string_view value() const
+    {
+      bool decoded = type == Type::STRING || type == Type::CHAR;
+      return std::string_view(text, decoded ? payload.text.size : length);
+    }
+
+    // Describe the token, resolving its row and column through the source manager
+    std::string toString(const SourceManager& sources) const;
+    std::string toString(const LineCol& lineCol) const;
 
     // Check if the token is NONE
     bool isNone() const;
@@ -51,32 +88,205 @@ namespace leor
     bool operator!() const;
   };
 
-  // Map of escape sequences
-  extern const hash_map<char, char> ESCAPE_SEQUENCES;
+  // Build the 256-entry table of escape sequences at compile time
+  constexpr std::array<int16_t, 256> MakeEscapeTable();
+
+  // Class Escapes - Decoding of the character after a backslash through a 256-entry table
+  // Entries hold the decoded character, or one of the negative markers.
+  class Escapes
+  {
+  private:
+    Escapes() { }
+  public:
+    enum Marker : int16_t
+    {
+      UNKNOWN = -1,
+      HEX     = -2, // \xNN
+      UNICODE = -3, // \u{N...}, encoded as UTF-8
+    };
+
+    static const std::array<int16_t, 256> TABLE;
+
+    static constexpr int16_t decode(char c)
+    {
+      return TABLE[static_cast<uint8_t>(c)];
+    }
+  };
+
+  constexpr std::array<int16_t, 256> MakeEscapeTable()
+  {
+    std::array<int16_t, 256> table{};
+    table.fill(Escapes::UNKNOWN);
+    auto add = [&table](char c, int16_t decoded)
+    {
+      table[static_cast<uint8_t>(c)] = decoded;
+    };
+
+    add('n', '\n');
+    add('r', '\r');
+    add('t', '\t');
+    add('v', '\v');
+    add('b', '\b');
+    add('a', '\a');
+    add('f', '\f');
+    add('\\', '\\');
+    add('\'', '\'');
+    add('\"', '\"');
+    add('0', '\0');
+    add('x', Escapes::HEX);
+    add('u', Escapes::UNICODE);
+    return table;
+  }
+
+  inline constexpr std::array<int16_t, 256> Escapes::TABLE = MakeEscapeTable();
+
+  // Code point of the decoded text of a character literal, or INVALID_CHAR
+  // The text is a single byte, taken as it is, or a single UTF-8 sequence.
+  inline constexpr char32_t INVALID_CHAR = 0xFFFFFFFF;
+  constexpr char32_t DecodeChar(std::string_view text)
+  {
+    if (text.size() == 1)
+    {
+      return static_cast<uint8_t>(text[0]);
+    }
+    if (text.empty())
+    {
+      return INVALID_CHAR;
+    }
+
+    auto lead = static_cast<uint8_t>(text[0]);
+    size_t size = lead >= 0xF0 && lead < 0xF8 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 0;
+    if (text.size() != size || lead >= 0xF8)
+    {
+      return INVALID_CHAR;
+    }
+    char32_t value = lead & (0x7F >> size);
+    for (size_t i = 1; i < size; i++)
+    {
+      auto c = static_cast<uint8_t>(text[i]);
+      if ((c & 0xC0) != 0x80)
+      {
+        return INVALID_CHAR;
+      }
+      value = value << 6 | (c & 0x3F);
+    }
+    // Overlong encodings, surrogates and values past Unicode are no code points
+    constexpr char32_t SMALLEST[] = { 0, 0, 0x80, 0x800, 0x10000 };
+    if (value < SMALLEST[size] || value > 0x10FFFF || (value >= 0xD800 && value <= 0xDFFF))
+    {
+      return INVALID_CHAR;
+    }
+    return value;
+  }
 
   // Class Lexer - A lexer for a stream of characters
   class Lexer
   {
   private:
     CharStream m_stream;
+    FileID m_file;
     Token m_current;
+    Arena m_arena;          // Decoded strings, and token text of streamed sources
+    std::string m_scratch;  // Text being assembled across escapes or pages
+    Diagnostics* m_diags;   // Without one, the first error throws
+    bool m_intern;          // Intern identifiers as they're read
   
   public:
-    Lexer(const std::string& buffer);
+    Lexer(std::string_view buffer, FileID file = 0, Diagnostics* diags = nullptr);
+    Lexer(PageRing& ring, FileID file = 0, Diagnostics* diags = nullptr);
+
+    // Location of the current stream position
+    SourceLoc loc();
+
+    // Continue lexing from a byte offset of a whole-buffer source
+    void seek(uint32_t offset);
 
-    std::string rdWhile(const std::function<bool(int8_t)>& pred);
-    std::string rdWhile(const std::function<bool(const std::string&)>& pred);
-    std::string rdEsc(const char& end);
+    // Leave identifiers with symbol 0, for the caller to intern once it keeps them
+    // Speculative lexing uses this so that text it misreads never reaches the interner.
+    void deferInterning() { m_intern = false; }
+
+    // Resolve a location in this lexer's buffer into a row and column
+    LineCol lineCol(const SourceLoc& loc) const;
+
+    // Report an error and carry on, or throw when there's nowhere to report it
+    void error(DiagCode code, const SourceLoc& loc, std::string_view arg = "");
+
+    // Consume a run of characters, returning a view that stays valid as long as the lexer
+    // Scanner is called as scan(begin, end) and returns where the run stops.
+    template <typename Scanner>
+    std::string_view rdSpan(Scanner scan)
+    {
+      auto span = m_stream.span();
+      auto end = span.data() + span.size();
+      auto stop = scan(span.data(), end);
+      m_stream.advance(stop - span.data());
+      if (stop != end || m_stream.eof())
+      {
+        return keep(std::string_view(span.data(), stop - span.data()));
+      }
+
+      // The run continues on the next page of a streamed source
+      m_scratch.assign(span.data(), stop);
+      for (span = m_stream.span(); !span.empty(); span = m_stream.span())
+      {
+        end = span.data() + span.size();
+        stop = scan(span.data(), end);
+        m_scratch.append(span.data(), stop);
+        m_stream.advance(stop - span.data());
+        if (stop != end)
+        {
+          break;
+        }
+      }
+      return m_arena.copy(m_scratch);
+    }
+
+    template <typename Pred>
+    std::string_view rdWhile(Pred pred)
+    {
+      return rdSpan([&pred](const char* begin, const char* end)
+      {
+        while (begin < end && pred(*begin))
+        {
+          begin++;
+        }
+        return begin;
+      });
+    }
+
+    // Consume a run recognized by a Scan kernel
+    std::string_view rdRun(Scan::Kernel scan);
+    void skipRun(Scan::Kernel scan);
+
+    // Read a string or char literal up to its closing quote
+    // Without escapes the value is a view of the source between the quotes. An
+    // unterminated literal is reported, and closed is set to false.
+    std::string_view rdEsc(const char& end, bool* closed = nullptr);
+    // Decode the escapes of a literal's text into the arena
+    std::string_view unescape(std::string_view raw, const SourceLoc& start);
+
+    // Make text taken from the stream outlive the current page of a streamed source
+    std::string_view keep(std::string_view text);
 
     void skipWhitespace();
     void skipComment();
 
+    // Read a number and decode its value
+    // Integers may be written in hex (0x) or binary (0b); any number may contain '_'
+    // separators. Decimal integers must fit an int64_t, hex and binary ones 64 bits.
     Token rdNumber();
     Token rdID();
     Token rdString();
     Token rdChar();
+    // Read the longest operator or punctuation through the grammar's DFA
+    Token rdSymbol();
     Token rdNext();
 
+    // Hand over the arena holding decoded token text
+    Arena takeArena();
+    // Go on keeping token text in another arena, handing over the current one
+    void swapArena(Arena& other);
+
     // Get the current token
     Token peek();
     // Get the next token
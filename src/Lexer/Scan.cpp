@@ -0,0 +1,240 @@
+#include "Lexer/Scan.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "Lexer/CharClass.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#define LEOR_SCAN_X86
+#endif
+
+namespace leor
+{
+
+  // Scalar kernels, also used for the tails of the vector kernels
+
+  static const char* WhitespaceScalar(const char* begin, const char* end)
+  {
+    while (begin < end && CharClass::is(*begin, CharClass::WHITESPACE))
+    {
+      begin++;
+    }
+    return begin;
+  }
+
+  static const char* IDScalar(const char* begin, const char* end)
+  {
+    while (begin < end && CharClass::is(*begin, CharClass::ID))
+    {
+      begin++;
+    }
+    return begin;
+  }
+
+  static const char* LineScalar(const char* begin, const char* end)
+  {
+    auto nl = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+    return nl ? nl : end;
+  }
+
+  static const char* QuotedScalar(const char* begin, const char* end, char quote)
+  {
+    while (begin < end && *begin != quote && *begin != '\\')
+    {
+      begin++;
+    }
+    return begin;
+  }
+
+#ifdef LEOR_SCAN_X86
+
+  // Whitespace is ' ' or '\t'..'\r', identifiers are [a-zA-Z0-9_]. Ranges are
+  // tested as (c - lo) <= (hi - lo) unsigned, which is min_epu8(x, n) == x.
+
+  static inline __m128i InRange16(__m128i v, char lo, char hi)
+  {
+    auto x = _mm_sub_epi8(v, _mm_set1_epi8(lo));
+    return _mm_cmpeq_epi8(_mm_min_epu8(x, _mm_set1_epi8(hi - lo)), x);
+  }
+
+  static inline __m128i Whitespace16(__m128i v)
+  {
+    return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), InRange16(v, '\t', '\r'));
+  }
+
+  static inline __m128i ID16(__m128i v)
+  {
+    auto alpha = InRange16(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+    auto digit = InRange16(v, '0', '9');
+    auto under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    return _mm_or_si128(_mm_or_si128(alpha, digit), under);
+  }
+
+  static const char* WhitespaceSSE2(const char* begin, const char* end)
+  {
+    for (; end - begin >= 16; begin += 16)
+    {
+      auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+      uint32_t mask = ~_mm_movemask_epi8(Whitespace16(v)) & 0xFFFF;
+      if (mask)
+      {
+        return begin + __builtin_ctz(mask);
+      }
+    }
+    return WhitespaceScalar(begin, end);
+  }
+
+  static const char* IDSSE2(const char* begin, const char* end)
+  {
+    for (; end - begin >= 16; begin += 16)
+    {
+      auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+      uint32_t mask = ~_mm_movemask_epi8(ID16(v)) & 0xFFFF;
+      if (mask)
+      {
+        return begin + __builtin_ctz(mask);
+      }
+    }
+    return IDScalar(begin, end);
+  }
+
+  static const char* LineSSE2(const char* begin, const char* end)
+  {
+    const auto nl = _mm_set1_epi8('\n');
+    for (; end - begin >= 16; begin += 16)
+    {
+      auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+      uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+      if (mask)
+      {
+        return begin + __builtin_ctz(mask);
+      }
+    }
+    return LineScalar(begin, end);
+  }
+
+  static const char* QuotedSSE2(const char* begin, const char* end, char quote)
+  {
+    const auto q = _mm_set1_epi8(quote);
+    const auto bs = _mm_set1_epi8('\\');
+    for (; end - begin >= 16; begin += 16)
+    {
+      auto v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+      uint32_t mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, bs)));
+      if (mask)
+      {
+        return begin + __builtin_ctz(mask);
+      }
+    }
+    return QuotedScalar(begin, end, quote);
+  }
+
+#define LEOR_AVX2 __attribute__((target("avx2")))
+
+  LEOR_AVX2 static inline __m256i InRange32(__m256i v, char lo, char hi)
+  {
+    auto x = _mm256_sub_epi8(v, _mm256_set1_epi8(lo));
+    return _mm256_cmpeq_epi8(_mm256_min_epu8(x, _mm256_set1_epi8(hi - lo)), x);
+  }
+
+  LEOR_AVX2 static const char* WhitespaceAVX2(const char* begin, const char* end)
+  {
+    for (; end - begin >= 32; begin += 32)
+    {
+      auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+      auto ws = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), InRange32(v, '\t', '\r'));
+      uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(ws));
+      if (mask)
+      {
+        return begin + __builtin_ctz(mask);
+      }
+    }
+    return WhitespaceSSE2(begin, end);
+  }
+
+  LEOR_AVX2 static const char* IDAVX2(const char* begin, const char* end)
+  {
+    for (; end - begin >= 32; begin += 32)
+    {
+      auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+      auto alpha = InRange32(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+      auto digit = InRange32(v, '0', '9');
+      auto under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+      auto id = _mm256_or_si256(_mm256_or_si256(alpha, digit), under);
+      uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(id));
+      if (mask)
+      {
+        return begin + __builtin_ctz(mask);
+      }
+    }
+    return IDSSE2(begin, end);
+  }
+
+  LEOR_AVX2 static const char* LineAVX2(const char* begin, const char* end)
+  {
+    const auto nl = _mm256_set1_epi8('\n');
+    for (; end - begin >= 32; begin += 32)
+    {
+      auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+      uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, nl));
+      if (mask)
+      {
+        return begin + __builtin_ctz(mask);
+      }
+    }
+    return LineSSE2(begin, end);
+  }
+
+  LEOR_AVX2 static const char* QuotedAVX2(const char* begin, const char* end, char quote)
+  {
+    const auto q = _mm256_set1_epi8(quote);
+    const auto bs = _mm256_set1_epi8('\\');
+    for (; end - begin >= 32; begin += 32)
+    {
+      auto v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+      uint32_t mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, q), _mm256_cmpeq_epi8(v, bs)));
+      if (mask)
+      {
+        return begin + __builtin_ctz(mask);
+      }
+    }
+    return QuotedSSE2(begin, end, quote);
+  }
+
+#undef LEOR_AVX2
+
+#endif // LEOR_SCAN_X86
+
+  static Scan::Kernels SelectKernels()
+  {
+    const Scan::Kernels scalar{ "scalar", WhitespaceScalar, IDScalar, LineScalar, QuotedScalar };
+#ifdef LEOR_SCAN_X86
+    const Scan::Kernels sse2{ "sse2", WhitespaceSSE2, IDSSE2, LineSSE2, QuotedSSE2 };
+    const Scan::Kernels avx2{ "avx2", WhitespaceAVX2, IDAVX2, LineAVX2, QuotedAVX2 };
+
+    __builtin_cpu_init();
+    bool hasAVX2 = __builtin_cpu_supports("avx2");
+    if (const char* forced = std::getenv("LEOR_SCAN"))
+    {
+      if (std::strcmp(forced, "scalar") == 0)
+      {
+        return scalar;
+      }
+      if (std::strcmp(forced, "sse2") == 0 || !hasAVX2)
+      {
+        return sse2;
+      }
+      return avx2;
+    }
+    return hasAVX2 ? avx2 : sse2;
+#else
+    return scalar;
+#endif
+  }
+
+  const Scan::Kernels Scan::kernels = SelectKernels();
+
+} // namespace leor
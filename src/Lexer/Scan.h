@@ -0,0 +1,51 @@
+#pragma once
+
+#ifndef LEOR_SCAN_H
+#define LEOR_SCAN_H
+
+namespace leor
+{
+
+  // Class Scan - Vectorized scanning of character runs
+  // Every kernel returns the first position in [begin, end) that ends the run, or end.
+  // SSE2 and AVX2 versions are picked at startup from what the CPU supports; set
+  // LEOR_SCAN=scalar|sse2|avx2 in the environment to force one.
+  class Scan
+  {
+  private:
+    Scan() { }
+  public:
+    using Kernel = const char* (*)(const char* begin, const char* end);
+    using QuoteKernel = const char* (*)(const char* begin, const char* end, char quote);
+
+    struct Kernels
+    {
+      const char* name;
+      Kernel whitespace;
+      Kernel id;
+      Kernel line;
+      QuoteKernel quoted;
+    };
+
+    // Skip a run of whitespace
+    static const char* whitespace(const char* begin, const char* end) { return kernels.whitespace(begin, end); }
+
+    // Skip a run of identifier characters
+    static const char* id(const char* begin, const char* end) { return kernels.id(begin, end); }
+
+    // Skip to the end of the line, stopping on the '\n'
+    static const char* line(const char* begin, const char* end) { return kernels.line(begin, end); }
+
+    // Skip the body of a string or char literal, stopping on the quote or a backslash
+    static const char* quoted(const char* begin, const char* end, char quote) { return kernels.quoted(begin, end, quote); }
+
+    // Name of the selected instruction set
+    static const char* isa() { return kernels.name; }
+
+  private:
+    static const Kernels kernels;
+  };
+
+} // namespace leor
+
+#endif //LEOR_SCAN_H
@@ -0,0 +1,68 @@
+#include "Lexer/TokenQueue.h"
+
+#include <bit>
+
+namespace leor
+{
+
+  namespace
+  {
+
+    // Wait until ready(index) holds for the value of an index the other side moves
+    // Spin a little first, as the other side is usually close behind; then sleep on the
+    // index, with the flag raised for the other side to wake us when it moves it.
+    template <typename Ready>
+    void Wait(std::atomic<uint64_t>& index, std::atomic<bool>& waits, Ready&& ready)
+    {
+      constexpr size_t SPINS = 64;
+      for (size_t i = 0; i < SPINS; i++)
+      {
+        if (ready(index.load(std::memory_order_acquire)))
+        {
+          return;
+        }
+      }
+
+      waits.store(true);
+      for (auto value = index.load(); !ready(value); value = index.load())
+      {
+        index.wait(value);
+      }
+      waits.store(false, std::memory_order_relaxed);
+    }
+
+  } // namespace
+
+  TokenQueue::TokenQueue(size_t capacity)
+    : m_slots(new Token[std::bit_ceil(std::max(capacity, 2 * BATCH))]),
+      m_mask(std::bit_ceil(std::max(capacity, 2 * BATCH)) - 1),
+      m_head(0), m_next(0), m_tailSeen(0), m_consumerWaits(false), m_tail(0), m_headSeen(0), m_producerWaits(false)
+  { }
+
+  bool TokenQueue::waitRoom()
+  {
+    // Whatever is pushed already must be visible, or the consumer could wait for it too
+    flush();
+    bool closed = false;
+    Wait(m_tail, m_producerWaits, [this, &closed](uint64_t tail)
+    {
+      closed = tail == CLOSED;
+      if (!closed)
+      {
+        m_tailSeen = tail;
+      }
+      return closed || m_next - m_tailSeen <= m_mask;
+    });
+    return !closed;
+  }
+
+  void TokenQueue::waitTokens(uint64_t tail)
+  {
+    Wait(m_head, m_consumerWaits, [this, tail](uint64_t head)
+    {
+      m_headSeen = head;
+      return m_headSeen != tail;
+    });
+  }
+
+} // namespace leor
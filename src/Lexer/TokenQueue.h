@@ -0,0 +1,119 @@
+#pragma once
+
+#ifndef LEOR_TOKENQUEUE_H
+#define LEOR_TOKENQUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "Lexer/Lexer.h"
+
+namespace leor
+{
+
+  // Class TokenQueue - A bounded lock-free queue of tokens from one thread to another
+  // One thread pushes and one pops. Each side keeps its index on a cache line of its
+  // own, along with the last index it saw of the other side, so they only read each
+  // other's line when that runs out. Pushed tokens are published in batches for the
+  // same reason: a single token never costs a synchronization. A side that has to wait
+  // spins briefly, then sleeps in std::atomic::wait on the other side's index, having
+  // raised a flag the other side checks when it moves the index, so that it's only
+  // woken when there's something to wake it for.
+  class TokenQueue
+  {
+  public:
+    static constexpr size_t DEFAULT_CAPACITY = 4096; // Tokens, rounded up to a power of 2
+    static constexpr size_t BATCH = 64;
+
+  private:
+    static constexpr size_t CACHE_LINE = 64;
+    static constexpr uint64_t CLOSED = UINT64_MAX; // m_tail once the consumer is gone
+
+    std::unique_ptr<Token[]> m_slots;
+    uint64_t m_mask;
+
+    // Producer
+    alignas(CACHE_LINE) std::atomic<uint64_t> m_head; // Tokens published
+    uint64_t m_next;      // Tokens pushed
+    uint64_t m_tailSeen;  // m_tail when last read
+    std::atomic<bool> m_consumerWaits; // Set by the consumer, asleep on m_head
+
+    // Consumer
+    alignas(CACHE_LINE) std::atomic<uint64_t> m_tail; // Tokens popped, or CLOSED
+    uint64_t m_headSeen;  // m_head when last read
+    std::atomic<bool> m_producerWaits; // Set by the producer, asleep on m_tail
+
+  public:
+    explicit TokenQueue(size_t capacity = DEFAULT_CAPACITY);
+
+    TokenQueue(const TokenQueue&) = delete;
+    TokenQueue& operator=(const TokenQueue&) = delete;
+
+    // Producer: add a token, waiting for room while the queue is full
+    // Returns false, dropping the token, once the consumer closed the queue.
+    bool push(const Token& tok)
+    {
+      if (m_next - m_tailSeen > m_mask && !waitRoom())
+      {
+        return false;
+      }
+      m_slots[m_next & m_mask] = tok;
+      m_next++;
+      if (m_next - m_head.load(std::memory_order_relaxed) >= BATCH)
+      {
+        flush();
+      }
+      return true;
+    }
+
+    // Producer: publish the tokens pushed so far
+    void flush()
+    {
+      // Sequentially consistent, as is the consumer's flag and its check of m_head
+      // after raising it: either it sees these tokens, or this sees it waiting
+      m_head.store(m_next);
+      if (m_consumerWaits.load())
+      {
+        m_head.notify_one();
+      }
+    }
+
+    // Consumer: take up to max tokens into out, waiting for at least one
+    size_t pop(Token* out, size_t max)
+    {
+      uint64_t tail = m_tail.load(std::memory_order_relaxed);
+      if (m_headSeen == tail)
+      {
+        waitTokens(tail);
+      }
+      size_t count = std::min<uint64_t>(max, m_headSeen - tail);
+      for (size_t i = 0; i < count; i++)
+      {
+        out[i] = m_slots[(tail + i) & m_mask];
+      }
+      m_tail.store(tail + count);
+      if (m_producerWaits.load())
+      {
+        m_tail.notify_one();
+      }
+      return count;
+    }
+
+    // Consumer: stop taking tokens, so that a producer waiting for room gives up
+    void close()
+    {
+      m_tail.store(CLOSED);
+      m_tail.notify_one();
+    }
+
+  private:
+    bool waitRoom();
+    void waitTokens(uint64_t tail);
+  };
+
+} // namespace leor
+
+#endif //LEOR_TOKENQUEUE_H
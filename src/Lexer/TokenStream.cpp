@@ -0,0 +1,462 @@
+#include "Lexer/TokenStream.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+namespace leor
+{
+
+  namespace
+  {
+
+    // Whether the token's text is in m_decoded rather than a view of the buffer
+    bool IsDecoded(Token::Type type, const Token::Payload& payload)
+    {
+      return (type == Token::Type::STRING || type == Token::Type::CHAR) && payload.text.decoded != 0;
+    }
+
+  } // namespace
+
+  TokenStream::TokenStream(std::string_view buffer, FileID file)
+    : m_buffer(buffer), m_file(file), m_dead(0), m_streamed(false), m_lines(buffer)
+  { }
+
+  TokenStream TokenStream::Streamed(FileID file)
+  {
+    TokenStream result(std::string_view(), file);
+    result.m_streamed = true;
+    return result;
+  }
+
+  TokenStream TokenStream::Tokenize(std::string_view buffer, FileID file, Diagnostics* diags)
+  {
+    TokenStream result(buffer, file);
+
+    // Roughly one token per four bytes of source
+    size_t estimate = buffer.size() / 4 + 1;
+    result.m_types.reserve(estimate);
+    result.m_offsets.reserve(estimate);
+    result.m_lengths.reserve(estimate);
+    result.m_payloads.reserve(estimate);
+
+    Lexer lexer(buffer, file, diags);
+    Token tok;
+    do
+    {
+      tok = lexer.rdNext();
+      result.push(tok);
+    } while (!tok.isEOB());
+
+    result.adopt(lexer.takeArena());
+    return result;
+  }
+
+  TokenStream TokenStream::TokenizeParallel(std::string_view buffer, FileID file, size_t threads, size_t minChunk, Diagnostics* diags)
+  {
+    if (threads == 0)
+    {
+      threads = std::max(1U, std::thread::hardware_concurrency());
+    }
+    size_t chunks = std::min(threads, buffer.size() / std::max<size_t>(minChunk, 1));
+    if (chunks <= 1)
+    {
+      return Tokenize(buffer, file, diags);
+    }
+
+    // Cut at line starts: comments never cross them, so only a string spanning
+    // several lines can make a chunk start in the middle of a token
+    std::vector<uint32_t> starts{ 0 };
+    for (size_t i = 1; i < chunks; i++)
+    {
+      size_t cut = buffer.size() * i / chunks;
+      auto nl = buffer.find('\n', std::max<size_t>(cut, starts.back()));
+      if (nl == std::string_view::npos)
+      {
+        break;
+      }
+      if (nl + 1 < buffer.size() && nl + 1 > starts.back())
+      {
+        starts.push_back(nl + 1);
+      }
+    }
+    chunks = starts.size();
+    starts.push_back(buffer.size());
+
+    struct Chunk
+    {
+      TokenStream tokens;
+      uint32_t next = 0;     // Where the token after the last one starts
+      bool complete = false; // The chunk was lexed without errors up to its end
+      Arena arena;
+    };
+    std::vector<Chunk> parts(chunks);
+
+    auto work = [&](size_t i)
+    {
+      auto& part = parts[i];
+      part.tokens = TokenStream(buffer, file);
+      part.tokens.m_types.reserve((starts[i + 1] - starts[i]) / 4 + 1);
+
+      // A mispredicted start can run into garbage: stop at the first error and
+      // leave the rest to the stitching, which reports real errors in order
+      Diagnostics speculative;
+      Lexer lexer(buffer, file, &speculative);
+      lexer.deferInterning();
+      lexer.seek(starts[i]);
+      while (true)
+      {
+        auto tok = lexer.rdNext();
+        if (!speculative.empty())
+        {
+          break;
+        }
+        if (i + 1 < chunks && tok.pos.offset >= starts[i + 1])
+        {
+          part.next = tok.pos.offset;
+          part.complete = true;
+          break;
+        }
+        part.tokens.push(tok);
+        if (tok.isEOB())
+        {
+          part.complete = true;
+          break;
+        }
+      }
+      part.arena = lexer.takeArena();
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < chunks; i++)
+    {
+      workers.emplace_back(work, i);
+    }
+    work(0);
+    for (auto& worker : workers)
+    {
+      worker.join();
+    }
+
+    TokenStream result(buffer, file);
+    size_t total = 0;
+    for (auto& part : parts)
+    {
+      total += part.tokens.size();
+    }
+    result.m_types.reserve(total);
+    result.m_offsets.reserve(total);
+    result.m_lengths.reserve(total);
+    result.m_payloads.reserve(total);
+
+    // Intern the identifiers of adopted tokens as they join the stream, so that
+    // symbols are numbered in source order just as the sequential lexer numbers them
+    auto take = [&result](const TokenStream& tokens, size_t from)
+    {
+      size_t first = result.size();
+      result.append(tokens, from, tokens.size());
+      for (size_t j = first; j < result.size(); j++)
+      {
+        if (result.m_types[j] == Token::Type::VAR)
+        {
+          result.m_payloads[j].symbol = Interner::Global().intern(result.m_buffer.substr(result.m_offsets[j], result.m_lengths[j]));
+        }
+      }
+    };
+
+    // The first chunk starts at the beginning, so it's always right
+    if (!parts[0].complete)
+    {
+      // It failed on a real error: let the sequential lexer report it
+      return Tokenize(buffer, file, diags);
+    }
+    take(parts[0].tokens, 0);
+    uint32_t next = parts[0].next;
+
+    Lexer repair(buffer, file, diags);
+    for (size_t i = 1; i < chunks; i++)
+    {
+      auto& part = parts[i];
+      size_t from = part.tokens.find(next);
+      if (from != npos)
+      {
+        take(part.tokens, from);
+        if (part.complete)
+        {
+          next = part.next;
+          continue;
+        }
+        // The speculation broke down later in the chunk: resume after its last good token
+        from = result.size() - 1;
+        repair.seek(result.offset(from) + result.length(from));
+      }
+      else
+      {
+        repair.seek(next);
+      }
+
+      // Lex sequentially until a token lines up with the speculation of a later chunk
+      while (true)
+      {
+        auto tok = repair.rdNext();
+        while (i + 1 < chunks && tok.pos.offset >= starts[i + 1])
+        {
+          i++;
+        }
+        auto& ahead = parts[i];
+        size_t match = tok.pos.offset >= starts[i] ? ahead.tokens.find(tok.pos.offset) : npos;
+        if (match != npos && (ahead.complete || match + 1 < ahead.tokens.size()))
+        {
+          take(ahead.tokens, match);
+          if (ahead.complete)
+          {
+            next = ahead.next;
+            break;
+          }
+          repair.seek(result.offset(result.size() - 1) + result.length(result.size() - 1));
+          continue;
+        }
+        result.push(tok);
+        if (tok.isEOB())
+        {
+          break;
+        }
+      }
+    }
+
+    for (auto& part : parts)
+    {
+      result.m_arenas.insert(result.m_arenas.end(),
+        std::make_move_iterator(part.tokens.m_arenas.begin()), std::make_move_iterator(part.tokens.m_arenas.end()));
+      result.adopt(std::move(part.arena));
+    }
+    result.adopt(repair.takeArena());
+    return result;
+  }
+
+  void TokenStream::push(const Token& tok)
+  {
+    auto payload = tok.payload;
+    if (m_streamed)
+    {
+      m_texts.push_back(tok.text);
+    }
+    else if (tok.type == Token::Type::STRING || tok.type == Token::Type::CHAR)
+    {
+      bool view = tok.text >= m_buffer.data() && tok.text <= m_buffer.data() + m_buffer.size();
+      if (view)
+      {
+        payload.text.decoded = 0;
+      }
+      else
+      {
+        m_decoded.push_back(tok.value());
+        payload.text.decoded = m_decoded.size();
+      }
+    }
+
+    m_types.push_back(tok.type);
+    m_offsets.push_back(tok.pos.offset);
+    m_lengths.push_back(tok.length);
+    m_payloads.push_back(payload);
+  }
+
+  TokenRange TokenStream::relex(std::string_view newBuffer, const TextEdit& edit, Diagnostics* diags)
+  {
+    if (m_streamed)
+    {
+      throw std::logic_error("TokenStream::relex: only whole-buffer streams can be relexed");
+    }
+    int64_t delta = int64_t(edit.inserted) - int64_t(edit.removed);
+    uint32_t newEnd = edit.offset + edit.inserted;  // In the new buffer
+
+    // Restart at the last token that ends strictly before the edit: a token touching
+    // it could grow, and comments between it and the edit get skipped again
+    auto it = std::lower_bound(m_offsets.begin(), m_offsets.end(), edit.offset);
+    size_t first = it - m_offsets.begin();
+    while (first > 0 && m_offsets[first - 1] + m_lengths[first - 1] >= edit.offset)
+    {
+      first--;
+    }
+    uint32_t restart = 0;
+    if (first > 0)
+    {
+      first--;
+      restart = m_offsets[first];
+    }
+
+    TokenStream fresh(newBuffer, m_file);
+    Lexer lexer(newBuffer, m_file, diags);
+    lexer.seek(restart);
+    size_t resync = size();
+    while (true)
+    {
+      auto tok = lexer.rdNext();
+      if (tok.pos.offset >= newEnd)
+      {
+        // Past the edit the old and new text are the same, so a token starting at
+        // the same place lexes the same way, and so does everything after it
+        size_t match = find(static_cast<uint32_t>(tok.pos.offset - delta));
+        if (match != npos)
+        {
+          resync = match;
+          break;
+        }
+      }
+      fresh.push(tok);
+      if (tok.isEOB())
+      {
+        break;
+      }
+    }
+
+    // Splice the fresh tokens in place of [first, resync) and shift the rest
+    size_t count = fresh.size();
+    auto splice = [&](auto& into, auto& from)
+    {
+      into.erase(into.begin() + first, into.begin() + resync);
+      into.insert(into.begin() + first, from.begin(), from.end());
+    };
+    for (size_t i = first; i < resync; i++)
+    {
+      m_dead += IsDecoded(m_types[i], m_payloads[i]);
+    }
+    // Decoded strings of the fresh tokens get renumbered into ours, and copied out of
+    // the lexer's arena, which would take a whole block per edit
+    for (size_t i = 0; i < count; i++)
+    {
+      if (IsDecoded(fresh.m_types[i], fresh.m_payloads[i]))
+      {
+        auto& decoded = fresh.m_payloads[i].text.decoded;
+        m_decoded.push_back(m_relexed.copy(fresh.m_decoded[decoded - 1]));
+        decoded = m_decoded.size();
+      }
+    }
+    splice(m_types, fresh.m_types);
+    splice(m_offsets, fresh.m_offsets);
+    splice(m_lengths, fresh.m_lengths);
+    splice(m_payloads, fresh.m_payloads);
+    for (size_t i = first + count; i < m_offsets.size(); i++)
+    {
+      m_offsets[i] += delta;
+    }
+
+    if (m_dead > m_decoded.size() / 2)
+    {
+      compact();
+    }
+    m_buffer = newBuffer;
+    m_lines = LineTable(newBuffer);
+    return TokenRange{ first, first + count };
+  }
+
+  void TokenStream::compact()
+  {
+    Arena arena;
+    std::vector<std::string_view> decoded;
+    decoded.reserve(m_decoded.size() - m_dead);
+    for (size_t i = 0; i < size(); i++)
+    {
+      if (IsDecoded(m_types[i], m_payloads[i]))
+      {
+        auto& index = m_payloads[i].text.decoded;
+        decoded.push_back(arena.copy(m_decoded[index - 1]));
+        index = decoded.size();
+      }
+    }
+    m_decoded = std::move(decoded);
+    m_arenas.clear();
+    m_relexed = std::move(arena);
+    m_dead = 0;
+  }
+
+  void TokenStream::append(const TokenStream& other, size_t from, size_t to)
+  {
+    m_types.insert(m_types.end(), other.m_types.begin() + from, other.m_types.begin() + to);
+    m_offsets.insert(m_offsets.end(), other.m_offsets.begin() + from, other.m_offsets.begin() + to);
+    m_lengths.insert(m_lengths.end(), other.m_lengths.begin() + from, other.m_lengths.begin() + to);
+    size_t first = m_payloads.size();
+    m_payloads.insert(m_payloads.end(), other.m_payloads.begin() + from, other.m_payloads.begin() + to);
+    if (other.m_streamed)
+    {
+      m_texts.insert(m_texts.end(), other.m_texts.begin() + from, other.m_texts.begin() + to);
+    }
+
+    // Decoded strings are numbered per stream
+    if (!other.m_decoded.empty())
+    {
+      for (size_t i = first; i < m_payloads.size(); i++)
+      {
+        auto type = m_types[i];
+        auto& decoded = m_payloads[i].text.decoded;
+        if ((type == Token::Type::STRING || type == Token::Type::CHAR) && decoded != 0)
+        {
+          m_decoded.push_back(other.m_decoded[decoded - 1]);
+          decoded = m_decoded.size();
+        }
+      }
+    }
+  }
+
+  size_t TokenStream::find(uint32_t offset) const
+  {
+    auto it = std::lower_bound(m_offsets.begin(), m_offsets.end(), offset);
+    return it != m_offsets.end() && *it == offset ? it - m_offsets.begin() : npos;
+  }
+
+  void TokenStream::adopt(Arena arena)
+  {
+    if (arena.capacity() != 0)
+    {
+      m_arenas.push_back(std::move(arena));
+    }
+  }
+
+  void TokenStream::discard(size_t count, Arena& arena)
+  {
+    count = std::min(count, size());
+    auto drop = [count](auto& v)
+    {
+      v.erase(v.begin(), v.begin() + std::min(count, v.size()));
+    };
+    drop(m_types);
+    drop(m_offsets);
+    drop(m_lengths);
+    drop(m_payloads);
+    drop(m_texts);
+    for (size_t i = 0; i < m_texts.size(); i++)
+    {
+      m_texts[i] = arena.copy((*this)[i].value()).data();
+    }
+  }
+
+  Token TokenStream::operator[](size_t i) const
+  {
+    Token tok;
+    tok.type = m_types[i];
+    tok.pos = SourceLoc{ m_offsets[i], m_file };
+    tok.length = m_lengths[i];
+    tok.payload = m_payloads[i];
+
+    if (m_streamed)
+    {
+      tok.text = m_texts[i];
+    }
+    else if (tok.type == Token::Type::STRING || tok.type == Token::Type::CHAR)
+    {
+      auto decoded = tok.payload.text.decoded;
+      tok.text = decoded ? m_decoded[decoded - 1].data() : m_buffer.data() + tok.pos.offset + 1;
+    }
+    else
+    {
+      tok.text = m_buffer.data() + tok.pos.offset;
+    }
+    return tok;
+  }
+
+  LineCol TokenStream::lineCol(const SourceLoc& loc) const
+  {
+    return m_lines.lineCol(loc.offset);
+  }
+
+} // namespace leor
@@ -0,0 +1,141 @@
+#pragma once
+
+#ifndef LEOR_TOKENSTREAM_H
+#define LEOR_TOKENSTREAM_H
+
+#include <vector>
+
+#include "Lexer/Lexer.h"
+
+namespace leor
+{
+
+  // Struct TextEdit - Replacement of a byte range of a buffer
+  struct TextEdit
+  {
+    uint32_t offset;   // Where the edit starts
+    uint32_t removed;  // Bytes removed from the old buffer
+    uint32_t inserted; // Bytes inserted in their place
+  };
+
+  // Struct TokenRange - Range of token indices
+  struct TokenRange
+  {
+    size_t begin;
+    size_t end;
+  };
+
+  // Class TokenStream - A sequence of tokens stored as parallel arrays
+  // Text is not stored: it is sliced out of the source buffer by offset and length,
+  // except for decoded strings and tokens of streamed sources, kept on the side.
+  // A stream produced by Tokenize() always ends with an EOB token.
+  class TokenStream
+  {
+  private:
+    std::string_view m_buffer;
+    FileID m_file;
+    std::vector<Token::Type> m_types;
+    std::vector<uint32_t> m_offsets;
+    std::vector<uint32_t> m_lengths;
+    std::vector<Token::Payload> m_payloads;
+    std::vector<std::string_view> m_decoded;
+    std::vector<const char*> m_texts; // Only for streamed sources without a buffer
+    std::vector<Arena> m_arenas;
+    Arena m_relexed;   // Decoded text of the tokens relex() produced
+    size_t m_dead;     // Entries of m_decoded that replaced tokens left behind
+    bool m_streamed;
+    LineTable m_lines;
+
+  public:
+    // An empty stream of tokens from buffer
+    explicit TokenStream(std::string_view buffer = std::string_view(), FileID file = 0);
+
+    // An empty stream of tokens from a streamed source, which has no buffer: the text
+    // of every token is kept on the side
+    static TokenStream Streamed(FileID file = 0);
+
+    TokenStream(TokenStream&&) = default;
+    TokenStream& operator=(TokenStream&&) = default;
+
+    static constexpr size_t DEFAULT_MIN_CHUNK = 256 * 1024;
+
+    // Tokenize a whole buffer in one loop
+    // Errors are reported to diags and lexing goes on; without diags the first one throws.
+    static TokenStream Tokenize(std::string_view buffer, FileID file = 0, Diagnostics* diags = nullptr);
+
+    // Tokenize a whole buffer on several threads, producing the same stream as Tokenize
+    // The buffer is cut into chunks at line starts and every chunk is lexed speculatively,
+    // as if no string literal were open at its start. The chunks are then stitched in
+    // order: a chunk is adopted from the first token that starts exactly where the
+    // stream so far expects the next token, since lexing from the same offset always
+    // yields the same tokens. Where that fails, a sequential lexer repairs the gap.
+    // threads = 0 uses every hardware thread. Only the sequential parts report to diags,
+    // so every error is reported once and in order. Likewise identifiers are interned
+    // only once their tokens are adopted, so misread text never becomes a symbol.
+    static TokenStream TokenizeParallel(
+      std::string_view buffer,
+      FileID file = 0,
+      size_t threads = 0,
+      size_t minChunk = DEFAULT_MIN_CHUNK,
+      Diagnostics* diags = nullptr
+    );
+
+    // Append a token produced by a lexer over this stream's buffer
+    void push(const Token& tok);
+
+    // Update the stream after an edit turned its buffer into newBuffer
+    // Only the tokens around the edit are lexed again, until the lexer produces a token
+    // that starts where an old one did in the unchanged text after the edit; from there on
+    // the old tokens are kept, shifted by the size difference. Returns the range of tokens
+    // that were replaced, in the updated stream. Errors in the lexed text go to diags.
+    // Streamed sources can't be relexed. The decoded text the replaced tokens leave
+    // behind is reclaimed once it makes up half of what's kept.
+    TokenRange relex(std::string_view newBuffer, const TextEdit& edit, Diagnostics* diags = nullptr);
+
+    // Append the tokens [from, to) of another stream over the same buffer
+    void append(const TokenStream& other, size_t from, size_t to);
+
+    // Take ownership of the arena the pushed tokens' decoded text lives in
+    void adopt(Arena arena);
+
+    // Drop the first count tokens, once nothing needs them anymore
+    // The text the rest of the tokens of a streamed source keep on the side is copied
+    // into arena, so that wherever it was can be reused. Indices shift down by count.
+    void discard(size_t count, Arena& arena);
+
+    // Index of the token starting at offset, or npos
+    size_t find(uint32_t offset) const;
+    static constexpr size_t npos = size_t(-1);
+
+    size_t size() const { return m_types.size(); }
+    bool empty() const { return m_types.empty(); }
+
+    Token::Type type(size_t i) const { return m_types[i]; }
+    uint32_t offset(size_t i) const { return m_offsets[i]; }
+    uint32_t length(size_t i) const { return m_lengths[i]; }
+    const Token::Payload& payload(size_t i) const { return m_payloads[i]; }
+
+    // The token's text, decoded for strings and chars
+    std::string_view value(size_t i) const
+    {
+      return (*this)[i].value();
+    }
+
+    // Rebuild the compact token at index i
+    Token operator[](size_t i) const;
+
+    std::string_view buffer() const { return m_buffer; }
+    FileID file() const { return m_file; }
+
+    // Resolve a location in the buffer into a row and column
+    LineCol lineCol(const SourceLoc& loc) const;
+
+  private:
+    // Copy the decoded text the tokens still use into an arena of its own, dropping
+    // the others
+    void compact();
+  };
+
+} // namespace leor
+
+#endif //LEOR_TOKENSTREAM_H
@@ -1,29 +1,38 @@
-#include <fstream>
 #include <iostream>
+#include "Diagnostics/Diagnostics.h"
+#include "Input/SourceManager.h"
+#include "Lexer/TokenStream.h"
 #include "Parser/Parser.h"
 
 int32_t main()
 {
-  std::ifstream file("tests/hello.leor");
-  std::stringstream buffer;
-  buffer << file.rdbuf();
+  leor::SourceManager sources;
+  auto file = sources.open("tests/hello.leor");
 
-  leor::Lexer lexer(buffer.str());
-  while (!lexer.eof())
+  leor::Diagnostics diags;
+  auto tokens = leor::TokenStream::Tokenize(sources.buffer(file), file, &diags);
+  for (size_t i = 0; i + 1 < tokens.size(); i++)
   {
-    std::cout << lexer.get().toString() << std::endl;
+    std::cout << tokens[i].toString(sources) << std::endl;
   }
 
-  leor::Parser parser(buffer.str());
+  leor::Parser parser(tokens, &diags);
   auto ast = parser();
-  if (ast.type == leor::AST::Type::PROG)
+  for (auto& diag : diags.all())
+  {
+    std::cerr << sources.name(file) << ":" << diag.toString() << std::endl;
+  }
+  if (!diags.empty())
+  {
+    return 1;
+  }
+  auto prog = ast.root();
+  if (prog->type == leor::Node::Type::PROG)
     std::cout << "ProgAST found" << std::endl;
 
-  auto prog = std::get<std::vector<leor::AST>>(ast.at("prog"));
-
-  for (auto& a : prog)
+  for (auto node : prog->prog)
   {
-    std::cout << (int64_t)a.type << std::endl;
+    std::cout << (int64_t)node->type << std::endl;
   }
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,86 @@
+#include "Memory/Arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace leor
+{
+
+  Arena::Arena(size_t blockSize)
+    : m_blockSize(blockSize), m_current(0), m_ptr(nullptr), m_end(nullptr)
+  { }
+
+  Arena::Arena(Arena&& other) noexcept
+    : m_blocks(std::move(other.m_blocks)), m_blockSize(other.m_blockSize),
+      m_current(other.m_current), m_ptr(other.m_ptr), m_end(other.m_end)
+  {
+    other.m_blocks.clear();
+    other.reset();
+  }
+
+  Arena& Arena::operator=(Arena&& other) noexcept
+  {
+    if (this != &other)
+    {
+      m_blocks = std::move(other.m_blocks);
+      m_blockSize = other.m_blockSize;
+      m_current = other.m_current;
+      m_ptr = other.m_ptr;
+      m_end = other.m_end;
+      other.m_blocks.clear();
+      other.reset();
+    }
+    return *this;
+  }
+
+  void* Arena::allocateSlow(size_t size, size_t align)
+  {
+    // Move on to the next block that fits, allocating one if none is left.
+    // Blocks skipped because they are too small are reused after reset().
+    size_t next = m_ptr == nullptr ? 0 : m_current + 1;
+    while (next < m_blocks.size() && m_blocks[next].size < size + align)
+    {
+      next++;
+    }
+    if (next >= m_blocks.size())
+    {
+      size_t blockSize = std::max(m_blockSize, size + align);
+      m_blocks.push_back(Block{ std::unique_ptr<char[]>(new char[blockSize]), blockSize });
+      next = m_blocks.size() - 1;
+    }
+
+    m_current = next;
+    m_ptr = m_blocks[next].data.get();
+    m_end = m_ptr + m_blocks[next].size;
+    return allocate(size, align);
+  }
+
+  std::string_view Arena::copy(std::string_view str)
+  {
+    if (str.empty())
+    {
+      return std::string_view();
+    }
+    auto p = static_cast<char*>(allocate(str.size(), 1));
+    std::memcpy(p, str.data(), str.size());
+    return std::string_view(p, str.size());
+  }
+
+  void Arena::reset()
+  {
+    m_current = 0;
+    m_ptr = nullptr;
+    m_end = nullptr;
+  }
+
+  size_t Arena::capacity() const
+  {
+    size_t total = 0;
+    for (auto& block : m_blocks)
+    {
+      total += block.size;
+    }
+    return total;
+  }
+
+} // namespace leor
@@ -0,0 +1,77 @@
+#pragma once
+
+#ifndef LEOR_ARENA_H
+#define LEOR_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace leor
+{
+
+  // Class Arena - A bump allocator handing out memory from a list of blocks
+  // Nothing is freed individually; everything goes at once on reset() or destruction.
+  // Allocated memory never moves, so pointers into it stay valid until then.
+  class Arena
+  {
+  public:
+    static constexpr size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+  private:
+    struct Block
+    {
+      std::unique_ptr<char[]> data;
+      size_t size;
+    };
+
+    std::vector<Block> m_blocks;
+    size_t m_blockSize;
+    size_t m_current; // Index of the block being allocated from
+    char* m_ptr;
+    char* m_end;
+
+  public:
+    explicit Arena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+
+    Arena(Arena&& other) noexcept;
+    Arena& operator=(Arena&& other) noexcept;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // Allocate size bytes aligned to align
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t))
+    {
+      auto p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(m_ptr) + align - 1) & ~(align - 1));
+      if (m_ptr == nullptr || p + size > m_end)
+      {
+        return allocateSlow(size, align);
+      }
+      m_ptr = p + size;
+      return p;
+    }
+
+    // Copy a string into the arena
+    std::string_view copy(std::string_view str);
+
+    // Give back the unused end of the most recent allocation, which now stops at end
+    void shrink(void* end)
+    {
+      m_ptr = static_cast<char*>(end);
+    }
+
+    // Release every allocation, keeping the blocks for reuse
+    void reset();
+
+    // Total bytes held by the arena
+    size_t capacity() const;
+
+  private:
+    void* allocateSlow(size_t size, size_t align);
+  };
+
+} // namespace leor
+
+#endif //LEOR_ARENA_H
@@ -0,0 +1,112 @@
+#include "Memory/Region.h"
+
+#include <algorithm>
+#include <new>
+#include <stdexcept>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace leor
+{
+
+  Region::Region(size_t reserve)
+    : m_base(nullptr), m_ptr(nullptr), m_committed(nullptr), m_reserve(reserve)
+  { }
+
+  Region::Region(Region&& other) noexcept
+    : m_base(other.m_base), m_ptr(other.m_ptr), m_committed(other.m_committed), m_reserve(other.m_reserve)
+  {
+    other.m_base = other.m_ptr = other.m_committed = nullptr;
+  }
+
+  Region& Region::operator=(Region&& other) noexcept
+  {
+    if (this != &other)
+    {
+      release();
+      m_base = other.m_base;
+      m_ptr = other.m_ptr;
+      m_committed = other.m_committed;
+      m_reserve = other.m_reserve;
+      other.m_base = other.m_ptr = other.m_committed = nullptr;
+    }
+    return *this;
+  }
+
+  Region::~Region()
+  {
+    release();
+  }
+
+  Region Region::Map(int fd, size_t size, size_t reserve)
+  {
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t mapped = (size + page - 1) / page * page;
+    Region region(std::max(reserve, mapped));
+
+    void* base = mmap(nullptr, region.m_reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED)
+    {
+      throw std::bad_alloc();
+    }
+    region.m_base = static_cast<char*>(base);
+    region.m_ptr = region.m_committed = region.m_base;
+
+    // The file replaces the start of the reservation, which keeps the rest for allocations
+    if (size > 0 && mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+      throw std::runtime_error("Error: Cannot map a file into a region");
+    }
+    region.m_ptr = region.m_base + size;
+    region.m_committed = region.m_base + mapped;
+    return region;
+  }
+
+  void Region::release()
+  {
+    if (m_base)
+    {
+      munmap(m_base, m_reserve);
+    }
+    m_base = m_ptr = m_committed = nullptr;
+  }
+
+  void* Region::allocateSlow(size_t size, size_t align)
+  {
+    if (m_base == nullptr)
+    {
+      // Inaccessible address space doesn't count against the commit limit
+      void* base = mmap(nullptr, m_reserve, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (base == MAP_FAILED)
+      {
+        throw std::bad_alloc();
+      }
+      m_base = m_ptr = m_committed = static_cast<char*>(base);
+    }
+
+    auto p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(m_ptr) + align - 1) & ~(align - 1));
+    size_t used = p + size - m_base;
+    if (used > m_reserve)
+    {
+      throw RegionFull();
+    }
+    size_t commit = std::min(m_reserve, (used + COMMIT_SIZE - 1) / COMMIT_SIZE * COMMIT_SIZE);
+    if (m_base + commit > m_committed)
+    {
+      if (mprotect(m_committed, m_base + commit - m_committed, PROT_READ | PROT_WRITE) != 0)
+      {
+        throw std::bad_alloc();
+      }
+      m_committed = m_base + commit;
+    }
+    m_ptr = p + size;
+    return p;
+  }
+
+  void Region::reset()
+  {
+    m_ptr = m_base;
+  }
+
+} // namespace leor
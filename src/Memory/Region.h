@@ -0,0 +1,84 @@
+#pragma once
+
+#ifndef LEOR_REGION_H
+#define LEOR_REGION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace leor
+{
+
+  // Class RegionFull - An allocation didn't fit in what's left of a region's reserve
+  // Unlike other bad_allocs, there may be memory to spare: it's the region that's full.
+  class RegionFull : public std::bad_alloc
+  {
+  public:
+    const char* what() const noexcept override { return "Region reserve exhausted"; }
+  };
+
+  // Class Region - A bump allocator over one contiguous range of address space
+  // The range is reserved up front and committed as allocations grow into it, so
+  // memory never moves and everything allocated lies between data() and data() + size().
+  // Nothing is freed individually; everything goes at once on reset() or destruction.
+  class Region
+  {
+  public:
+    // Everything within 2 GiB stays reachable through 32-bit offsets
+    static constexpr size_t DEFAULT_RESERVE = size_t(1) << 31;
+    static constexpr size_t COMMIT_SIZE = 1 << 20;
+
+  private:
+    char* m_base;
+    char* m_ptr;
+    char* m_committed;
+    size_t m_reserve;
+
+  public:
+    // Address space is only reserved on the first allocation
+    explicit Region(size_t reserve = DEFAULT_RESERVE);
+
+    // Map the first size bytes of a file as the start of a new region
+    // The mapping is private: writes to it stay in memory, and allocations go after it.
+    static Region Map(int fd, size_t size, size_t reserve = DEFAULT_RESERVE);
+
+    Region(Region&& other) noexcept;
+    Region& operator=(Region&& other) noexcept;
+    Region(const Region&) = delete;
+    Region& operator=(const Region&) = delete;
+    ~Region();
+
+    // Allocate size bytes aligned to align
+    // Throws RegionFull past the reserve, and std::bad_alloc if the memory can't be had.
+    void* allocate(size_t size, size_t align = alignof(std::max_align_t))
+    {
+      auto p = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(m_ptr) + align - 1) & ~(align - 1));
+      if (m_ptr == nullptr || p + size > m_committed)
+      {
+        return allocateSlow(size, align);
+      }
+      m_ptr = p + size;
+      return p;
+    }
+
+    char* data() const { return m_base; }
+    size_t size() const { return m_ptr - m_base; }
+
+    // Check if p points into the allocated part of the region
+    bool contains(const void* p) const
+    {
+      return p >= m_base && p < m_ptr;
+    }
+
+    // Release every allocation in O(1), keeping the committed memory for reuse
+    void reset();
+
+  private:
+    void* allocateSlow(size_t size, size_t align);
+    void release();
+  };
+
+} // namespace leor
+
+#endif //LEOR_REGION_H
@@ -1,153 +1,463 @@
 #include "Parser/AST.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace leor
 {
-  using namespace std::string_literals;
 
-  AST& AST::set(Type type)
+  AST::AST()
+    : m_root(nullptr), m_dead(0)
+  { }
+
+  AST::AST(Region region, ProgNode* root)
+    : m_region(std::move(region)), m_root(root), m_dead(0)
+  { }
+
+  AST::AST(AST&& other) noexcept
+    : m_region(std::move(other.m_region)), m_root(other.m_root), m_dead(other.m_dead)
   {
-    this->type = type;
-    return *this;
+    other.m_root = nullptr;
+    other.m_dead = 0;
   }
 
-  AST& AST::set(const std::tuple<uint64_t, uint64_t>& pos)
+  AST& AST::operator=(AST&& other) noexcept
   {
-    this->pos = pos;
+    if (this != &other)
+    {
+      m_region = std::move(other.m_region);
+      m_root = other.m_root;
+      m_dead = other.m_dead;
+      other.m_root = nullptr;
+      other.m_dead = 0;
+    }
     return *this;
   }
 
-  AST& AST::set(const std::string& key, const AST& value)
+  void AST::reset()
   {
-    values.insert_or_assign(key, Base(std::move(value)));
-    return *this;
+    m_region.reset();
+    m_root = nullptr;
+    m_dead = 0;
+  }
+
+  void AST::compact()
+  {
+    AST live;
+    live.setRoot(static_cast<ProgNode*>(live.Clone(m_root)));
+    *this = std::move(live);
+  }
+
+  size_t AST::Bytes(const Node* node, bool shallow)
+  {
+    size_t bytes = 0;
+    std::vector<Node*> stack;
+    if (node)
+    {
+      stack.push_back(const_cast<Node*>(node));
+    }
+    while (!stack.empty())
+    {
+      auto top = stack.back();
+      stack.pop_back();
+      switch (top->type)
+      {
+        case Node::Type::BOOL:
+          bytes += sizeof(BoolNode);
+          break;
+        case Node::Type::INT:
+          bytes += sizeof(IntNode);
+          break;
+        case Node::Type::FLOAT:
+          bytes += sizeof(FloatNode);
+          break;
+        case Node::Type::STRING:
+          bytes += sizeof(StringNode) + top->as<StringNode>()->value.view().size();
+          break;
+        case Node::Type::CHAR:
+          bytes += sizeof(CharNode);
+          break;
+        case Node::Type::VAR:
+          bytes += sizeof(VarNode);
+          break;
+        case Node::Type::FUNCTION:
+          bytes += sizeof(FunctionNode) + top->as<FunctionNode>()->args.size() * sizeof(RelPtr<Node>);
+          break;
+        case Node::Type::VARIABLE:
+          bytes += sizeof(VariableNode);
+          break;
+        case Node::Type::CALL:
+          bytes += sizeof(CallNode) + top->as<CallNode>()->args.size() * sizeof(RelPtr<Node>);
+          break;
+        case Node::Type::BINARY:
+          bytes += sizeof(BinaryNode);
+          break;
+        case Node::Type::ASSIGN:
+          bytes += sizeof(AssignNode);
+          break;
+        case Node::Type::PROG:
+        {
+          auto prog = top->as<ProgNode>();
+          bytes += sizeof(ProgNode) + prog->prog.size() * sizeof(RelPtr<Node>) + prog->starts.size() * sizeof(uint32_t);
+          break;
+        }
+        case Node::Type::RETURN:
+          bytes += sizeof(ReturnNode);
+          break;
+        case Node::Type::UNARY:
+          bytes += sizeof(UnaryNode);
+          break;
+        default:
+          break;
+      }
+      if (!shallow)
+      {
+        ForEachChild(top, [&stack](RelPtr<Node>& child) { stack.push_back(child); });
+      }
+    }
+    return bytes;
   }
 
-  AST AST::None()
+  std::span<RelPtr<Node>> AST::List(std::span<Node* const> items)
   {
-    return AST().set(AST::Type::NONE);
+    auto list = static_cast<RelPtr<Node>*>(m_region.allocate(items.size() * sizeof(RelPtr<Node>), alignof(RelPtr<Node>)));
+    for (size_t i = 0; i < items.size(); i++)
+    {
+      new (&list[i]) RelPtr<Node>();
+      list[i] = items[i];
+    }
+    return std::span<RelPtr<Node>>(list, items.size());
   }
 
-  AST AST::Bool(const bool& value, const std::tuple<uint64_t, uint64_t> pos)
+  std::span<uint32_t> AST::Offsets(std::span<const uint32_t> offsets)
   {
-    return AST().set(AST::Type::BOOL).set(pos).set("value", value);
+    auto array = static_cast<uint32_t*>(m_region.allocate(offsets.size() * sizeof(uint32_t), alignof(uint32_t)));
+    std::copy(offsets.begin(), offsets.end(), array);
+    return std::span<uint32_t>(array, offsets.size());
   }
 
-  AST AST::Int(const int64_t& value, const std::tuple<uint64_t, uint64_t> pos)
+  void AST::Shift(Node* node, uint32_t from, int64_t delta, const Node* skip)
   {
-    return AST().set(AST::Type::INT).set(pos).set("value", value);
+    if (delta == 0)
+    {
+      return;
+    }
+
+    auto shift = [from, delta](uint32_t& offset)
+    {
+      if (offset >= from)
+      {
+        offset = static_cast<uint32_t>(offset + delta);
+      }
+    };
+
+    // Trees can be as deep as their source is long: walk them on a stack of our own
+    std::vector<Node*> stack{ node };
+    while (!stack.empty())
+    {
+      auto top = stack.back();
+      stack.pop_back();
+      if (top == skip)
+      {
+        continue;
+      }
+
+      shift(top->pos.offset);
+      if (auto prog = top->as<ProgNode>())
+      {
+        if (prog->closed())
+        {
+          shift(prog->end);
+        }
+        for (auto& start : prog->starts)
+        {
+          shift(start);
+        }
+      }
+      else if (auto function = top->as<FunctionNode>(); function && function->lazy())
+      {
+        shift(function->bodyBegin);
+        shift(function->bodyEnd);
+      }
+      ForEachChild(top, [&stack](RelPtr<Node>& child) { stack.push_back(child); });
+    }
+  }
+
+  size_t AST::mark()
+  {
+    // Aligning the marks keeps every node aligned wherever the block is copied to
+    m_region.allocate(0, BLOCK_ALIGN);
+    return m_region.size();
   }
 
-  AST AST::Float(const double& value, const std::tuple<uint64_t, uint64_t> pos)
+  ptrdiff_t AST::Splice(const AST& other, size_t begin, size_t end)
   {
-    return AST().set(AST::Type::FLOAT).set(pos).set("value", value);
+    auto block = static_cast<char*>(m_region.allocate(end - begin, BLOCK_ALIGN));
+    std::memcpy(block, other.m_region.data() + begin, end - begin);
+    return block - (other.m_region.data() + begin);
   }
 
-  AST AST::String(const std::string& value, const std::tuple<uint64_t, uint64_t> pos)
+  BoolNode* AST::Bool(bool value, const SourceLoc& pos)
   {
-    return AST().set(AST::Type::STRING).set(pos).set("value", value);
+    auto node = make<BoolNode>(pos);
+    node->value = value;
+    return node;
   }
 
-  AST AST::Char(const char& value, const std::tuple<uint64_t, uint64_t> pos)
+  IntNode* AST::Int(int64_t value, const SourceLoc& pos)
   {
-    return AST().set(AST::Type::CHAR).set(pos).set("value", value);
+    auto node = make<IntNode>(pos);
+    node->value = value;
+    return node;
   }
 
-  AST AST::Var(const std::string& value, const std::tuple<uint64_t, uint64_t> pos)
+  FloatNode* AST::Float(double value, const SourceLoc& pos)
   {
-    return AST().set(AST::Type::VAR).set(pos).set("value", value);
+    auto node = make<FloatNode>(pos);
+    node->value = value;
+    return node;
   }
 
-  AST AST::Function(
-    const std::string& name,
-    const std::vector<AST>& args,
-    const AST& body,
-    const std::string& type,
-    const std::tuple<uint64_t, uint64_t> pos
+  StringNode* AST::String(std::string_view value, const SourceLoc& pos)
+  {
+    auto text = static_cast<char*>(m_region.allocate(value.size(), 1));
+    std::memcpy(text, value.data(), value.size());
+    auto node = make<StringNode>(pos);
+    node->value = std::string_view(text, value.size());
+    return node;
+  }
+
+  CharNode* AST::Char(char32_t value, const SourceLoc& pos)
+  {
+    auto node = make<CharNode>(pos);
+    node->value = value;
+    return node;
+  }
+
+  VarNode* AST::Var(Symbol name, const SourceLoc& pos)
+  {
+    auto node = make<VarNode>(pos);
+    node->name = name;
+    return node;
+  }
+
+  FunctionNode* AST::Function(
+    Symbol name,
+    std::span<RelPtr<Node>> args,
+    Node* body,
+    Symbol type,
+    const SourceLoc& pos
   ) {
-    
-    return AST()
-      .set(AST::Type::FUNCTION)
-      .set(pos)
-      .set("name", name)
-      .set("args", args)
-      .set("type", type)
-      .set("body", body);
-  }
-
-  AST AST::Variable(
-    const std::string& name,
-    const std::string& type,
-    const AST& value,
-    const bool& is_constant,
-    const std::tuple<uint64_t, uint64_t> pos
+
+    auto node = make<FunctionNode>(pos);
+    node->name = name;
+    node->args = args;
+    node->body = body;
+    node->returnType = type;
+    return node;
+  }
+
+  VariableNode* AST::Variable(
+    Symbol name,
+    Symbol type,
+    Node* value,
+    bool isConst,
+    const SourceLoc& pos
   ) {
 
-    return AST()
-      .set(AST::Type::VARIABLE)
-      .set(pos)
-      .set("name", name)
-      .set("type", type)
-      .set("value", value)
-      .set("is_constant", is_constant);
+    auto node = make<VariableNode>(pos);
+    node->name = name;
+    node->varType = type;
+    node->value = value;
+    node->isConst = isConst;
+    return node;
   }
 
-  AST AST::Call(
-    AST function,
-    const std::vector<AST>& args,
-    const std::tuple<uint64_t, uint64_t> pos
+  CallNode* AST::Call(
+    Node* function,
+    std::span<RelPtr<Node>> args,
+    const SourceLoc& pos
   ) {
 
-    return AST()
-      .set(AST::Type::CALL)
-      .set(pos)
-      .set("function", function)
-      .set("args", args);
+    auto node = make<CallNode>(pos);
+    node->function = function;
+    node->args = args;
+    return node;
   }
 
-  AST AST::Binary(
-    const std::string& op,
-    const AST& left,
-    const AST& right,
-    const std::tuple<uint64_t, uint64_t> pos
+  BinaryNode* AST::Binary(
+    Op op,
+    Node* left,
+    Node* right,
+    const SourceLoc& pos
   ) {
 
-    return AST()
-      .set(AST::Type::BINARY)
-      .set(pos)
-      .set("op", op)
-      .set("left", left)
-      .set("right", right);
+    auto node = make<BinaryNode>(pos);
+    node->op = op;
+    node->left = left;
+    node->right = right;
+    return node;
   }
 
-  AST AST::Assign(
-    const std::string& op,
-    const AST& left,
-    const AST& right,
-    const std::tuple<uint64_t, uint64_t> pos
+  AssignNode* AST::Assign(
+    Op op,
+    Node* left,
+    Node* right,
+    const SourceLoc& pos
   ) {
 
-    return AST::Binary(op, left, right, pos)
-      .set(AST::Type::ASSIGN);
+    auto node = make<AssignNode>(pos);
+    node->op = op;
+    node->left = left;
+    node->right = right;
+    return node;
   }
 
-  AST AST::Prog(
-    const std::vector<AST>& prog,
-    const std::tuple<uint64_t, uint64_t> pos
+  ProgNode* AST::Prog(
+    std::span<RelPtr<Node>> prog,
+    const SourceLoc& pos
   ) {
 
-    return AST()
-      .set(AST::Type::PROG)
-      .set(pos)
-      .set("prog", prog);
-  }
-
-  const std::unordered_map<std::string, uint64_t> OP_PRECEDENCE
-  {{
-    {"=",  1},
-    {"||", 2},
-    {"&&", 3},
-    {"<",  7}, {">",  7}, {"<=", 7}, {">=", 7}, {"==", 7}, {"!=", 7},
-    {"+", 10}, {"-", 10},
-    {"*", 20}, {"/", 20}, {"%", 20},
-  }};
+    auto node = make<ProgNode>(pos);
+    node->prog = prog;
+    return node;
+  }
+
+  ReturnNode* AST::Return(Node* value, const SourceLoc& pos)
+  {
+    auto node = make<ReturnNode>(pos);
+    node->value = value;
+    return node;
+  }
+
+  UnaryNode* AST::Unary(Op op, Node* operand, const SourceLoc& pos)
+  {
+    auto node = make<UnaryNode>(pos);
+    node->op = op;
+    node->operand = operand;
+    return node;
+  }
+
+  Node* AST::Clone(const Node* node)
+  {
+    if (!node)
+    {
+      return nullptr;
+    }
+
+    // Trees can be as deep as their source is long: each copy is made with empty
+    // children, and the children are copied into their slots off a stack of our own
+    std::vector<std::pair<const Node*, RelPtr<Node>*>> stack;
+    auto child = [&stack](const Node* from, RelPtr<Node>& slot)
+    {
+      if (from)
+      {
+        stack.emplace_back(from, &slot);
+      }
+    };
+    auto list = [this, &child](const RelList<Node>& items)
+    {
+      std::vector<Node*> none(items.size(), nullptr);
+      auto copies = List(none);
+      for (size_t i = 0; i < items.size(); i++)
+      {
+        child(items.data()[i], copies[i]);
+      }
+      return copies;
+    };
+
+    auto shallow = [&](const Node* node) -> Node*
+    {
+      switch (node->type)
+      {
+        case Node::Type::BOOL:
+          return Bool(node->as<BoolNode>()->value, node->pos);
+        case Node::Type::INT:
+          return Int(node->as<IntNode>()->value, node->pos);
+        case Node::Type::FLOAT:
+          return Float(node->as<FloatNode>()->value, node->pos);
+        case Node::Type::STRING:
+          return String(node->as<StringNode>()->value.view(), node->pos);
+        case Node::Type::CHAR:
+          return Char(node->as<CharNode>()->value, node->pos);
+        case Node::Type::VAR:
+          return Var(node->as<VarNode>()->name, node->pos);
+        case Node::Type::FUNCTION:
+        {
+          auto function = node->as<FunctionNode>();
+          auto copy = Function(function->name, list(function->args), nullptr, function->returnType, node->pos);
+          child(function->body, copy->body);
+          copy->bodyBegin = function->bodyBegin;
+          copy->bodyEnd = function->bodyEnd;
+          copy->depth = function->depth;
+          return copy;
+        }
+        case Node::Type::VARIABLE:
+        {
+          auto variable = node->as<VariableNode>();
+          auto copy = Variable(variable->name, variable->varType, nullptr, variable->isConst, node->pos);
+          child(variable->value, copy->value);
+          return copy;
+        }
+        case Node::Type::CALL:
+        {
+          auto call = node->as<CallNode>();
+          auto copy = Call(nullptr, list(call->args), node->pos);
+          child(call->function, copy->function);
+          return copy;
+        }
+        case Node::Type::BINARY:
+        {
+          auto binary = node->as<BinaryNode>();
+          auto copy = Binary(binary->op, nullptr, nullptr, node->pos);
+          child(binary->left, copy->left);
+          child(binary->right, copy->right);
+          return copy;
+        }
+        case Node::Type::ASSIGN:
+        {
+          auto assign = node->as<AssignNode>();
+          auto copy = Assign(assign->op, nullptr, nullptr, node->pos);
+          child(assign->left, copy->left);
+          child(assign->right, copy->right);
+          return copy;
+        }
+        case Node::Type::PROG:
+        {
+          auto prog = node->as<ProgNode>();
+          auto copy = Prog(list(prog->prog), node->pos);
+          copy->starts = Offsets(std::span<const uint32_t>(prog->starts.data(), prog->starts.size()));
+          copy->end = prog->end;
+          copy->depth = prog->depth;
+          copy->unskipped = prog->unskipped;
+          return copy;
+        }
+        case Node::Type::RETURN:
+        {
+          auto copy = Return(nullptr, node->pos);
+          child(node->as<ReturnNode>()->value, copy->value);
+          return copy;
+        }
+        case Node::Type::UNARY:
+        {
+          auto unary = node->as<UnaryNode>();
+          auto copy = Unary(unary->op, nullptr, node->pos);
+          child(unary->operand, copy->operand);
+          return copy;
+        }
+        default:
+          throw std::runtime_error("Can't clone a node of type " + std::to_string(static_cast<int>(node->type)));
+      }
+    };
+
+    auto root = shallow(node);
+    while (!stack.empty())
+    {
+      auto [from, slot] = stack.back();
+      stack.pop_back();
+      *slot = shallow(from);
+    }
+    return root;
+  }
+
 } // namespace leor
@@ -3,38 +3,157 @@
 #ifndef LEOR_AST_H
 #define LEOR_AST_H
 
-#include <variant>
+#include <cstring>
+#include <new>
+#include <span>
+#include <type_traits>
 
 #include "Lexer/Lexer.h"
+#include "Memory/Region.h"
 
 namespace leor
 {
+
+  // Class RelPtr - A pointer stored as a 32-bit offset from its own address
+  // Nodes only point into the region they live in, so a block of nodes can be copied
+  // or mapped anywhere as plain bytes. Copying a single RelPtr would break it.
+  template <typename T>
+  class RelPtr
+  {
+  private:
+    int32_t m_offset; // 0 for null: nothing points at itself
+
+  public:
+    RelPtr() : m_offset(0) { }
+    RelPtr(const RelPtr&) = delete;
+    RelPtr& operator=(const RelPtr&) = delete;
+
+    RelPtr& operator=(T* p)
+    {
+      m_offset = p ? static_cast<int32_t>(reinterpret_cast<const char*>(p) - reinterpret_cast<const char*>(this)) : 0;
+      return *this;
+    }
+
+    T* get() const
+    {
+      return m_offset ? reinterpret_cast<T*>(const_cast<char*>(reinterpret_cast<const char*>(this)) + m_offset) : nullptr;
+    }
+
+    T* operator->() const { return get(); }
+    operator T*() const { return get(); }
+  };
+
+  // Class RelList - An array of RelPtr, referenced like a RelPtr
+  template <typename T>
+  class RelList
+  {
+  private:
+    int32_t m_offset;
+    uint32_t m_size;
+
+  public:
+    // Iterates over the elements as plain pointers
+    class iterator
+    {
+    private:
+      const RelPtr<T>* m_it;
+    public:
+      explicit iterator(const RelPtr<T>* it) : m_it(it) { }
+      T* operator*() const { return m_it->get(); }
+      iterator& operator++() { m_it++; return *this; }
+      bool operator==(const iterator& other) const = default;
+    };
+
+    RelList() : m_offset(0), m_size(0) { }
+    RelList(const RelList&) = delete;
+    RelList& operator=(const RelList&) = delete;
+
+    RelList& operator=(std::span<RelPtr<T>> items)
+    {
+      m_offset = items.empty() ? 0 : static_cast<int32_t>(reinterpret_cast<const char*>(items.data()) - reinterpret_cast<const char*>(this));
+      m_size = items.size();
+      return *this;
+    }
+
+    const RelPtr<T>* data() const
+    {
+      return reinterpret_cast<const RelPtr<T>*>(reinterpret_cast<const char*>(this) + m_offset);
+    }
+
+    RelPtr<T>* data()
+    {
+      return reinterpret_cast<RelPtr<T>*>(reinterpret_cast<char*>(this) + m_offset);
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    T* operator[](size_t i) const { return data()[i].get(); }
+    iterator begin() const { return iterator(data()); }
+    iterator end() const { return iterator(data() + m_size); }
+  };
+
+  // Class RelArray - An array of plain values, referenced like a RelPtr
   template <typename T>
-  struct Base {
-    T value;
+  class RelArray
+  {
+  private:
+    int32_t m_offset;
+    uint32_t m_size;
+
+  public:
+    RelArray() : m_offset(0), m_size(0) { }
+    RelArray(const RelArray&) = delete;
+    RelArray& operator=(const RelArray&) = delete;
+
+    RelArray& operator=(std::span<T> items)
+    {
+      m_offset = items.empty() ? 0 : static_cast<int32_t>(reinterpret_cast<const char*>(items.data()) - reinterpret_cast<const char*>(this));
+      m_size = items.size();
+      return *this;
+    }
 
-    Base(const T& value) : value(value) {}
+    T* data() const
+    {
+      return reinterpret_cast<T*>(const_cast<char*>(reinterpret_cast<const char*>(this)) + m_offset);
+    }
 
-    inline T& get() { return value; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    T& operator[](size_t i) const { return data()[i]; }
+    T* begin() const { return data(); }
+    T* end() const { return data() + m_size; }
   };
 
-  struct AST
+  // Class RelString - Text stored in the same region as the node holding it
+  class RelString
   {
   private:
-    AST() = default;
-  
+    int32_t m_offset;
+    uint32_t m_size;
+
   public:
-    using Value = std::variant<
-      bool,
-      int64_t,
-      double,
-      std::string,
-      char,
-      Base<AST>,
-      std::vector<AST> 
-    >;
-
-    enum class Type
+    RelString() : m_offset(0), m_size(0) { }
+    RelString(const RelString&) = delete;
+    RelString& operator=(const RelString&) = delete;
+
+    RelString& operator=(std::string_view text)
+    {
+      m_offset = text.empty() ? 0 : static_cast<int32_t>(text.data() - reinterpret_cast<const char*>(this));
+      m_size = text.size();
+      return *this;
+    }
+
+    std::string_view view() const
+    {
+      return std::string_view(reinterpret_cast<const char*>(this) + m_offset, m_size);
+    }
+  };
+
+  // Struct Node - The part every node of the syntax tree starts with
+  // Its type tells which of the node structs below it is.
+  struct Node
+  {
+    enum class Type : uint8_t
     {
       NONE,
       BOOL, INT, FLOAT, STRING, CHAR, VAR,
@@ -42,89 +161,297 @@ namespace leor
       IF, WHILE, FOR,
       ASSIGN, BINARY,
       PROG,
+      RETURN,
+      UNARY,
     };
 
     Type type;
-    std::map<std::string, Value> values;
-    std::tuple<uint64_t, uint64_t> pos;
+    SourceLoc pos;
+
+    Node(Type type, const SourceLoc& pos) : type(type), pos(pos) { }
+    Node(const Node&) = delete;
+    Node& operator=(const Node&) = delete;
 
-    Value& operator[](const std::string& key)
+    // View the node as the struct of its type, or nullptr if it's of another type
+    template <typename T>
+    T* as()
     {
-      return values[key];
+      return type == T::TYPE ? static_cast<T*>(this) : nullptr;
     }
 
-    const Value& at(const std::string& key) const
+    template <typename T>
+    const T* as() const
     {
-      return values.at(key);
+      return type == T::TYPE ? static_cast<const T*>(this) : nullptr;
     }
+  };
 
-  private:
-    AST& set(Type type);
-    AST& set(const std::tuple<uint64_t, uint64_t>& pos);
-    AST& set(const std::string& key, const AST& value);
-    
-    template <typename T>
-    AST& set(const std::string& key, const T& value)
+  struct BoolNode : Node
+  {
+    static constexpr Type TYPE = Type::BOOL;
+    bool value;
+  };
+
+  struct IntNode : Node
+  {
+    static constexpr Type TYPE = Type::INT;
+    int64_t value;
+  };
+
+  struct FloatNode : Node
+  {
+    static constexpr Type TYPE = Type::FLOAT;
+    double value;
+  };
+
+  struct StringNode : Node
+  {
+    static constexpr Type TYPE = Type::STRING;
+    RelString value;
+  };
+
+  struct CharNode : Node
+  {
+    static constexpr Type TYPE = Type::CHAR;
+    char32_t value; // A code point, or a lone byte such as \xFF as it is
+  };
+
+  struct VarNode : Node
+  {
+    static constexpr Type TYPE = Type::VAR;
+    Symbol name;
+  };
+
+  struct FunctionNode : Node
+  {
+    static constexpr Type TYPE = Type::FUNCTION;
+    Symbol name;
+    Symbol returnType;
+    RelList<Node> args;
+    RelPtr<Node> body; // nullptr while the body is skipped
+    uint32_t bodyBegin; // Source range of a skipped body, from its '{' to past its '}'
+    uint32_t bodyEnd;   // Both are 0 once it's parsed
+    uint32_t depth;     // Nesting depth the body is parsed at
+
+    bool lazy() const { return bodyBegin != bodyEnd; }
+  };
+
+  struct VariableNode : Node
+  {
+    static constexpr Type TYPE = Type::VARIABLE;
+    Symbol name;
+    Symbol varType;
+    RelPtr<Node> value; // nullptr without an initializer
+    bool isConst;
+  };
+
+  struct CallNode : Node
+  {
+    static constexpr Type TYPE = Type::CALL;
+    RelPtr<Node> function;
+    RelList<Node> args;
+  };
+
+  struct BinaryNode : Node
+  {
+    static constexpr Type TYPE = Type::BINARY;
+    Op op;
+    RelPtr<Node> left;
+    RelPtr<Node> right;
+
+    std::string_view opText() const { return Grammar::text(op); }
+  };
+
+  struct AssignNode : Node
+  {
+    static constexpr Type TYPE = Type::ASSIGN;
+    Op op;
+    RelPtr<Node> left;
+    RelPtr<Node> right;
+
+    std::string_view opText() const { return Grammar::text(op); }
+  };
+
+  struct ProgNode : Node
+  {
+    static constexpr Type TYPE = Type::PROG;
+    RelList<Node> prog;
+    RelArray<uint32_t> starts; // Offsets the elements start at, only kept for the top level
+    uint32_t end;   // Offset past the closing '}', 0 at the top level or if it wasn't closed
+    uint32_t depth; // Nesting depth the block was parsed at
+    uint32_t unskipped; // At the top level of a lazy parse: offset of the first function
+                        // body that was parsed as it couldn't be skipped, or UINT32_MAX.
+                        // Whether it can be depends on the text after it.
+
+    // A closed block was parsed from a clean state, and can be parsed again on its own
+    bool closed() const { return end != 0; }
+  };
+
+  struct ReturnNode : Node
+  {
+    static constexpr Type TYPE = Type::RETURN;
+    RelPtr<Node> value; // nullptr for a bare return
+  };
+
+  struct UnaryNode : Node
+  {
+    static constexpr Type TYPE = Type::UNARY;
+    Op op;
+    RelPtr<Node> operand;
+
+    std::string_view opText() const { return Grammar::text(op); }
+  };
+
+  // Call f on the slot of every child of node that isn't null
+  template <typename F>
+  void ForEachChild(Node* node, F&& f)
+  {
+    auto one = [&f](RelPtr<Node>& slot)
     {
-      values.insert_or_assign(key, value);
-      return *this;
+      if (slot)
+      {
+        f(slot);
+      }
+    };
+    auto list = [&one](RelList<Node>& items)
+    {
+      for (size_t i = 0; i < items.size(); i++)
+      {
+        one(items.data()[i]);
+      }
+    };
+
+    switch (node->type)
+    {
+      case Node::Type::FUNCTION:
+        list(static_cast<FunctionNode*>(node)->args);
+        one(static_cast<FunctionNode*>(node)->body);
+        break;
+      case Node::Type::VARIABLE:
+        one(static_cast<VariableNode*>(node)->value);
+        break;
+      case Node::Type::CALL:
+        one(static_cast<CallNode*>(node)->function);
+        list(static_cast<CallNode*>(node)->args);
+        break;
+      case Node::Type::BINARY:
+        one(static_cast<BinaryNode*>(node)->left);
+        one(static_cast<BinaryNode*>(node)->right);
+        break;
+      case Node::Type::ASSIGN:
+        one(static_cast<AssignNode*>(node)->left);
+        one(static_cast<AssignNode*>(node)->right);
+        break;
+      case Node::Type::PROG:
+        list(static_cast<ProgNode*>(node)->prog);
+        break;
+      case Node::Type::RETURN:
+        one(static_cast<ReturnNode*>(node)->value);
+        break;
+      case Node::Type::UNARY:
+        one(static_cast<UnaryNode*>(node)->operand);
+        break;
+      default:
+        break;
     }
+  }
+
+  // A subtree only moves as a pointer, or on purpose through AST::Clone
+  static_assert(!std::is_copy_constructible_v<Node> && !std::is_copy_assignable_v<Node>, "Nodes are never copied");
+  static_assert(!std::is_copy_constructible_v<RelPtr<Node>>, "A copied RelPtr points elsewhere");
+
+  // Class AST - The syntax tree of a compilation, and the region its nodes live in
+  // Nodes are bump-allocated and never freed on their own: the whole tree goes at once.
+  // Children are RelPtrs, so the nodes of a subtree parsed in one go form one block of
+  // bytes that can be copied or mapped elsewhere as it is. Nodes the tree drops, such as
+  // those an edit replaced, are only counted, until compact() leaves them behind.
+  class AST
+  {
+  private:
+    static constexpr size_t BLOCK_ALIGN = alignof(std::max_align_t);
 
+    Region m_region;
+    ProgNode* m_root;
+    size_t m_dead; // Bytes of the nodes dropped from the tree
 
-    // Constructors
   public:
-    static AST None();
+    AST();
+    // Take over a region holding a tree already, such as one mapped from a file
+    AST(Region region, ProgNode* root);
 
-    static AST Bool(
-      const bool& value,
-      const std::tuple<uint64_t, uint64_t> pos = std::make_tuple(0UL, 0UL)
-    );
+    AST(const AST&) = delete;
+    AST& operator=(const AST&) = delete;
+    AST(AST&& other) noexcept;
+    AST& operator=(AST&& other) noexcept;
 
-    static AST Int(
-      const int64_t& value,
-      const std::tuple<uint64_t, uint64_t> pos = std::make_tuple(0UL, 0UL)
-    );
+    ProgNode* root() const { return m_root; }
+    void setRoot(ProgNode* root) { m_root = root; }
 
-    static AST Float(
-      const double& value,
-      const std::tuple<uint64_t, uint64_t> pos = std::make_tuple(0UL, 0UL)
-    );
+    // Bytes taken by the nodes, from data() on
+    const char* data() const { return m_region.data(); }
+    size_t size() const { return m_region.size(); }
 
-    static AST String(
-      const std::string& value,
-      const std::tuple<uint64_t, uint64_t> pos = std::make_tuple(0UL, 0UL)
-    );
+    // Drop every node at once, keeping the memory for the next ones
+    void reset();
 
-    static AST Char(
-      const char& value,
-      const std::tuple<uint64_t, uint64_t> pos = std::make_tuple(0UL, 0UL)
-    );
+    // Bytes of the region taken by nodes no longer in the tree
+    size_t dead() const { return m_dead; }
+    // Count bytes of the region as taken by nodes no longer in the tree
+    void drop(size_t bytes) { m_dead += bytes; }
+    // Copy the tree into a region of its own, without the dropped nodes
+    // Every node moves: pointers into the tree from before are stale.
+    void compact();
 
-    static AST Var(
-      const std::string& value,
-      const std::tuple<uint64_t, uint64_t> pos = std::make_tuple(0UL, 0UL)
-    );
+    // Bytes a subtree takes in a region, padding aside: with its children's, unless
+    // shallow, and with the lists, offsets and text of its own either way
+    static size_t Bytes(const Node* node, bool shallow = false);
+
+    // Copy a list of children into the tree, for a node to reference
+    std::span<RelPtr<Node>> List(std::span<Node* const> items);
+
+    // Copy an array of source offsets into the tree, for a node to reference
+    std::span<uint32_t> Offsets(std::span<const uint32_t> offsets);
+
+    // Move every source offset at or after from by delta, in the subtree of node
+    // The subtree of skip, if it's in there, is left alone.
+    static void Shift(Node* node, uint32_t from, int64_t delta, const Node* skip = nullptr);
 
-    static AST Function(
-      const std::string& name,
-      const std::vector<AST>& args,
-      const AST& body,
-      const std::string& type,
-      const std::tuple<uint64_t, uint64_t> pos = std::make_tuple(0UL, 0UL)
+    // Offset the next node will be allocated at
+    // Nodes allocated between two marks only point among themselves when they make up
+    // whole subtrees, and can then be moved as one block by Splice.
+    size_t mark();
+
+    // Copy the nodes another tree allocated between two of its marks into this one
+    // Returns how far they moved: a node at p in other is at p + shift in this tree.
+    ptrdiff_t Splice(const AST& other, size_t begin, size_t end);
+
+    BoolNode* Bool(bool value, const SourceLoc& pos = SourceLoc());
+    IntNode* Int(int64_t value, const SourceLoc& pos = SourceLoc());
+    FloatNode* Float(double value, const SourceLoc& pos = SourceLoc());
+    StringNode* String(std::string_view value, const SourceLoc& pos = SourceLoc());
+    CharNode* Char(char32_t value, const SourceLoc& pos = SourceLoc());
+    VarNode* Var(Symbol name, const SourceLoc& pos = SourceLoc());
+
+    FunctionNode* Function(
+      Symbol name,
+      std::span<RelPtr<Node>> args,
+      Node* body,
+      Symbol type,
+      const SourceLoc& pos = SourceLoc()
     );
 
-    static AST Variable(
-      const std::string& name,
-      const std::string& type,
-      const AST& value,
-      const bool& is_constant,
-      const std::tuple<uint64_t, uint64_t> pos = std::make_tuple(0UL, 0UL)
+    VariableNode* Variable(
+      Symbol name,
+      Symbol type,
+      Node* value,
+      bool isConst,
+      const SourceLoc& pos = SourceLoc()
     );
 
-    static AST Call(
-      AST function,
-      const std::vector<AST>& args,
-      const std::tuple<uint64_t, uint64_t> pos = std::make_tuple(0UL, 0UL)
+    CallNode* Call(
+      Node* function,
+      std::span<RelPtr<Node>> args,
+      const SourceLoc& pos = SourceLoc()
     );
 
     // static AST If(); // TODO
@@ -133,27 +460,41 @@ namespace leor
 
     // static AST For(); // TODO
 
-    static AST Binary(
-      const std::string& op,
-      const AST& left,
-      const AST& right,
-      const std::tuple<uint64_t, uint64_t> pos = std::make_tuple(0UL, 0UL)
+    BinaryNode* Binary(
+      Op op,
+      Node* left,
+      Node* right,
+      const SourceLoc& pos = SourceLoc()
     );
 
-    static AST Assign(
-      const std::string& op,
-      const AST& left,
-      const AST& right,
-      const std::tuple<uint64_t, uint64_t> pos = std::make_tuple(0UL, 0UL)
+    AssignNode* Assign(
+      Op op,
+      Node* left,
+      Node* right,
+      const SourceLoc& pos = SourceLoc()
     );
 
-    static AST Prog(
-      const std::vector<AST>& prog,
-      const std::tuple<uint64_t, uint64_t> pos = std::make_tuple(0UL, 0UL)
+    ProgNode* Prog(
+      std::span<RelPtr<Node>> prog,
+      const SourceLoc& pos = SourceLoc()
     );
-  };
 
-  extern const std::unordered_map<std::string, uint64_t> OP_PRECEDENCE;
+    ReturnNode* Return(Node* value, const SourceLoc& pos = SourceLoc());
+
+    UnaryNode* Unary(Op op, Node* operand, const SourceLoc& pos = SourceLoc());
+
+    // Deep copy of a subtree, which may live in another tree, into this one
+    Node* Clone(const Node* node);
+
+  private:
+    // Allocate a node with every field but the common ones left to the caller
+    template <typename T>
+    T* make(const SourceLoc& pos)
+    {
+      static_assert(std::is_trivially_destructible_v<T>, "Nodes are never destroyed");
+      return new (m_region.allocate(sizeof(T), alignof(T))) T{ { T::TYPE, pos } };
+    }
+  };
 } // namespace leor
 
-#endif // LEOR_AST_H
\ No newline at end of file
+#endif // LEOR_AST_H
@@ -0,0 +1,95 @@
+#pragma once
+
+#ifndef LEOR_OPERATORS_H
+#define LEOR_OPERATORS_H
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+
+#include "Lexer/Grammar.h"
+
+namespace leor
+{
+
+  enum class Assoc : uint8_t
+  {
+    LEFT, RIGHT
+  };
+
+  // Struct OpInfo - How an operator binds in an expression
+  // Binding powers are 0 where the operator can't be used that way. Infix powers are
+  // even, so that a left associative operator binds its right operand one step tighter.
+  struct OpInfo
+  {
+    uint8_t infix;   // Binary operator: binding power to the operands
+    Assoc assoc;
+    uint8_t prefix;  // Unary operator: binding power to the operand after it
+    uint8_t postfix; // Binding power to the operand before it
+  };
+
+  // Class Operators - The binding of every symbol in expressions, indexed by Op
+  // Symbols that bind nowhere, such as '->' and ':', end an expression.
+  class Operators
+  {
+  private:
+    Operators() { }
+
+  public:
+    static const std::array<OpInfo, Grammar::SYMBOLS.size()> TABLE;
+
+    static constexpr const OpInfo& info(Op op);
+
+    // Binding power of the right operand of a binary operator
+    static constexpr uint8_t rightPower(Op op);
+  };
+
+  constexpr std::array<OpInfo, Grammar::SYMBOLS.size()> MakeOperatorTable()
+  {
+    std::array<OpInfo, Grammar::SYMBOLS.size()> table{};
+    auto infix = [&table](std::initializer_list<Op> ops, uint8_t power, Assoc assoc)
+    {
+      for (auto op : ops)
+      {
+        table[static_cast<size_t>(op)].infix = power;
+        table[static_cast<size_t>(op)].assoc = assoc;
+      }
+    };
+
+    infix({ Op::ASSIGN, Op::ADD_ASSIGN, Op::SUB_ASSIGN, Op::MUL_ASSIGN, Op::DIV_ASSIGN, Op::MOD_ASSIGN }, 2, Assoc::RIGHT);
+    infix({ Op::OR }, 4, Assoc::LEFT);
+    infix({ Op::AND }, 6, Assoc::LEFT);
+    infix({ Op::BIT_OR }, 8, Assoc::LEFT);
+    infix({ Op::BIT_XOR }, 10, Assoc::LEFT);
+    infix({ Op::BIT_AND }, 12, Assoc::LEFT);
+    infix({ Op::EQ, Op::NE, Op::LT, Op::GT, Op::LE, Op::GE }, 14, Assoc::LEFT);
+    infix({ Op::ADD, Op::SUB }, 20, Assoc::LEFT);
+    infix({ Op::MUL, Op::DIV, Op::MOD }, 40, Assoc::LEFT);
+
+    table[static_cast<size_t>(Op::SUB)].prefix = 50;
+    table[static_cast<size_t>(Op::NOT)].prefix = 50;
+
+    // A call
+    table[static_cast<size_t>(Op::LPAREN)].postfix = 60;
+    return table;
+  }
+
+  inline constexpr std::array<OpInfo, Grammar::SYMBOLS.size()> Operators::TABLE = MakeOperatorTable();
+
+  constexpr const OpInfo& Operators::info(Op op)
+  {
+    return TABLE[static_cast<size_t>(op)];
+  }
+
+  constexpr uint8_t Operators::rightPower(Op op)
+  {
+    auto& binding = info(op);
+    return binding.assoc == Assoc::RIGHT ? binding.infix : binding.infix + 1;
+  }
+
+  static_assert(Operators::rightPower(Op::ASSIGN) == Operators::info(Op::ASSIGN).infix, "Assignment is right associative");
+  static_assert(Operators::info(Op::ARROW).infix == 0 && Operators::info(Op::COLON).infix == 0, "'->' and ':' end an expression");
+
+} // namespace leor
+
+#endif // LEOR_OPERATORS_H
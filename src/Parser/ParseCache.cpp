@@ -0,0 +1,391 @@
+#include "Parser/ParseCache.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Lexer/TokenStream.h"
+#include "Parser/Parser.h"
+
+namespace leor
+{
+
+  namespace
+  {
+
+    // Struct CacheHeader - The start of a cache file
+    // The file is mapped as the region of the tree, so the nodes follow at NODES as
+    // they were laid out in the region they were parsed into. All offsets are from the
+    // start of the file.
+    struct CacheHeader
+    {
+      char magic[4];
+      uint32_t format;
+      uint64_t key;
+      uint64_t sourceSize;
+      uint64_t size;
+      uint64_t root;
+      uint64_t nodesEnd;
+      uint64_t symbols;  // CacheSymbol of every symbol the nodes use, by id
+      uint64_t names;    // Their text
+      uint64_t fixups;   // Offsets of the Symbols in the nodes, as uint32_t
+      uint32_t symbolCount;
+      uint32_t fixupCount;
+      FileID file;       // The file in the positions of the nodes
+    };
+
+    struct CacheSymbol
+    {
+      uint32_t id;
+      uint32_t offset; // From CacheHeader::names
+      uint32_t size;
+    };
+
+    // Aligned like the start of a region, so the nodes keep their alignment
+    constexpr size_t NODES = 128;
+    static_assert(sizeof(CacheHeader) <= NODES, "The header must fit before the nodes");
+    static_assert(NODES % alignof(std::max_align_t) == 0, "Nodes must stay aligned in the file");
+
+    constexpr char MAGIC[4] = { 'L', 'E', 'O', 'R' };
+
+    bool WriteAll(int fd, const void* data, size_t size)
+    {
+      auto p = static_cast<const char*>(data);
+      while (size > 0)
+      {
+        auto written = write(fd, p, size);
+        if (written < 0 && errno == EINTR)
+        {
+          continue;
+        }
+        if (written <= 0)
+        {
+          return false;
+        }
+        p += written;
+        size -= written;
+      }
+      return true;
+    }
+
+    // Hash of the layout of every node: the type, size and alignment of each struct,
+    // and the offset and size of each of its members, measured on nodes of a tree
+    // of our own. A build that lays out nodes differently never reads our trees back.
+    uint64_t Layout()
+    {
+      static const uint64_t layout = []
+      {
+        AST ast;
+        std::vector<uint64_t> facts;
+        auto node = [&facts](const auto* node, auto... members)
+        {
+          using T = std::remove_cvref_t<decltype(*node)>;
+          facts.push_back(uint64_t(T::TYPE) << 48 | uint64_t(sizeof(T)) << 16 | alignof(T));
+          auto at = reinterpret_cast<const char*>(node);
+          (facts.push_back(uint64_t(reinterpret_cast<const char*>(&(node->*members)) - at) << 32 | sizeof(node->*members)), ...);
+        };
+        auto none = std::span<RelPtr<Node>>();
+        node(ast.Bool(false), &Node::type, &Node::pos, &BoolNode::value);
+        node(ast.Int(0), &IntNode::value);
+        node(ast.Float(0), &FloatNode::value);
+        node(ast.String(""), &StringNode::value);
+        node(ast.Char(0), &CharNode::value);
+        node(ast.Var(Symbol{}), &VarNode::name);
+        node(ast.Function(Symbol{}, none, nullptr, Symbol{}), &FunctionNode::name, &FunctionNode::returnType,
+          &FunctionNode::args, &FunctionNode::body, &FunctionNode::bodyBegin, &FunctionNode::bodyEnd, &FunctionNode::depth);
+        node(ast.Variable(Symbol{}, Symbol{}, nullptr, false), &VariableNode::name, &VariableNode::varType,
+          &VariableNode::value, &VariableNode::isConst);
+        node(ast.Call(nullptr, none), &CallNode::function, &CallNode::args);
+        node(ast.Binary(Op::NONE, nullptr, nullptr), &BinaryNode::op, &BinaryNode::left, &BinaryNode::right);
+        node(ast.Assign(Op::NONE, nullptr, nullptr), &AssignNode::op, &AssignNode::left, &AssignNode::right);
+        node(ast.Prog(none), &ProgNode::prog, &ProgNode::starts, &ProgNode::end, &ProgNode::depth, &ProgNode::unskipped);
+        node(ast.Return(nullptr), &ReturnNode::value);
+        node(ast.Unary(Op::NONE, nullptr), &UnaryNode::op, &UnaryNode::operand);
+        return ParseCache::Hash(std::string_view(reinterpret_cast<const char*>(facts.data()), facts.size() * sizeof(uint64_t)), ParseCache::FORMAT);
+      }();
+      return layout;
+    }
+
+    // Call f on every node of the tree, on a stack of our own
+    template <typename F>
+    void ForEachNode(Node* root, F&& f)
+    {
+      std::vector<Node*> stack{ root };
+      while (!stack.empty())
+      {
+        auto node = stack.back();
+        stack.pop_back();
+        f(node);
+        ForEachChild(node, [&stack](RelPtr<Node>& child) { stack.push_back(child); });
+      }
+    }
+
+  } // namespace
+
+  ParseCache::ParseCache(std::string dir)
+    : m_dir(std::move(dir))
+  {
+    mkdir(m_dir.c_str(), 0755);
+  }
+
+  uint64_t ParseCache::Hash(std::string_view data, uint64_t seed)
+  {
+    // The rounds and constants of xxHash64
+    constexpr uint64_t P1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t P3 = 0x165667B19E3779F9ULL;
+    constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr uint64_t P5 = 0x27D4EB2F165667C5ULL;
+    auto round = [](uint64_t acc, uint64_t word) { return std::rotl(acc + word * P2, 31) * P1; };
+    auto word = [](const char* p)
+    {
+      uint64_t w;
+      std::memcpy(&w, p, sizeof(w));
+      return w;
+    };
+
+    auto p = data.data();
+    auto end = p + data.size();
+    uint64_t hash = seed + P5;
+    if (data.size() >= 32)
+    {
+      uint64_t lanes[4] = { seed + P1 + P2, seed + P2, seed, seed - P1 };
+      for (; p + 32 <= end; p += 32)
+      {
+        lanes[0] = round(lanes[0], word(p));
+        lanes[1] = round(lanes[1], word(p + 8));
+        lanes[2] = round(lanes[2], word(p + 16));
+        lanes[3] = round(lanes[3], word(p + 24));
+      }
+      hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+      for (auto lane : lanes)
+      {
+        hash = (hash ^ round(0, lane)) * P1 + P4;
+      }
+    }
+    hash += data.size();
+
+    for (; p + 8 <= end; p += 8)
+    {
+      hash = std::rotl(hash ^ round(0, word(p)), 27) * P1 + P4;
+    }
+    for (; p < end; p++)
+    {
+      hash = std::rotl(hash ^ static_cast<uint8_t>(*p) * P5, 11) * P1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= P2;
+    hash ^= hash >> 29;
+    hash *= P3;
+    hash ^= hash >> 32;
+    return hash;
+  }
+
+  uint64_t ParseCache::Key(std::string_view source, uint64_t settings)
+  {
+    return Hash(source, Layout() ^ settings);
+  }
+
+  std::string ParseCache::path(uint64_t key) const
+  {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llx.ast", static_cast<unsigned long long>(key));
+    return m_dir + name;
+  }
+
+  std::optional<AST> ParseCache::load(std::string_view source, FileID file, uint64_t settings) const
+  {
+    auto key = Key(source, settings);
+    int fd = open(path(key).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+      return std::nullopt;
+    }
+
+    CacheHeader header;
+    struct stat st;
+    bool valid = fstat(fd, &st) == 0 && pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+      std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.format == FORMAT &&
+      header.key == key && header.sourceSize == source.size() &&
+      header.size == static_cast<uint64_t>(st.st_size) &&
+      header.root >= NODES && header.root + sizeof(ProgNode) <= header.nodesEnd && header.nodesEnd <= header.symbols &&
+      header.symbols + header.symbolCount * sizeof(CacheSymbol) <= header.names && header.names <= header.fixups &&
+      header.fixups + header.fixupCount * sizeof(uint32_t) <= header.size;
+
+    std::optional<Region> region;
+    if (valid)
+    {
+      try
+      {
+        region = Region::Map(fd, header.size);
+      }
+      catch (const std::exception&)
+      {
+      }
+    }
+    close(fd);
+    if (!region)
+    {
+      return std::nullopt;
+    }
+
+    // Symbols are numbered by interning order: only renumber them when it differs
+    auto base = region->data();
+    auto symbols = reinterpret_cast<const CacheSymbol*>(base + header.symbols);
+    std::vector<std::pair<uint32_t, uint32_t>> renumber;
+    for (size_t i = 0; i < header.symbolCount; i++)
+    {
+      auto sym = Interner::Global().intern(std::string_view(base + header.names + symbols[i].offset, symbols[i].size));
+      if (sym.id != symbols[i].id)
+      {
+        renumber.emplace_back(symbols[i].id, sym.id);
+      }
+    }
+    if (!renumber.empty())
+    {
+      auto fixups = reinterpret_cast<const uint32_t*>(base + header.fixups);
+      for (size_t i = 0; i < header.fixupCount; i++)
+      {
+        auto sym = reinterpret_cast<Symbol*>(base + fixups[i]);
+        auto it = std::lower_bound(renumber.begin(), renumber.end(), std::make_pair(sym->id, uint32_t(0)));
+        if (it != renumber.end() && it->first == sym->id)
+        {
+          sym->id = it->second;
+        }
+      }
+    }
+
+    auto root = reinterpret_cast<ProgNode*>(base + header.root);
+    if (header.file != file)
+    {
+      ForEachNode(root, [file](Node* node) { node->pos.file = file; });
+    }
+    return AST(std::move(*region), root);
+  }
+
+  bool ParseCache::store(std::string_view source, const AST& ast, uint64_t settings) const
+  {
+    auto root = ast.root();
+    if (!root)
+    {
+      return false;
+    }
+
+    // Find every symbol the nodes use, and where
+    std::vector<uint32_t> fixups;
+    std::vector<uint32_t> ids;
+    auto use = [&](const Symbol& sym)
+    {
+      // The empty name is 0 everywhere
+      if (sym.id == 0)
+      {
+        return;
+      }
+      fixups.push_back(static_cast<uint32_t>(NODES + (reinterpret_cast<const char*>(&sym) - ast.data())));
+      ids.push_back(sym.id);
+    };
+    FileID file = root->pos.file;
+    ForEachNode(root, [&use](Node* node)
+    {
+      if (auto var = node->as<VarNode>())
+      {
+        use(var->name);
+      }
+      else if (auto function = node->as<FunctionNode>())
+      {
+        use(function->name);
+        use(function->returnType);
+      }
+      else if (auto variable = node->as<VariableNode>())
+      {
+        use(variable->name);
+        use(variable->varType);
+      }
+    });
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+    std::vector<CacheSymbol> symbols;
+    std::string names;
+    for (auto id : ids)
+    {
+      auto name = Interner::Global().name(Symbol{ id });
+      symbols.push_back(CacheSymbol{ id, static_cast<uint32_t>(names.size()), static_cast<uint32_t>(name.size()) });
+      names += name;
+    }
+
+    CacheHeader header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.format = FORMAT;
+    header.key = Key(source, settings);
+    header.sourceSize = source.size();
+    header.root = NODES + (reinterpret_cast<const char*>(root) - ast.data());
+    header.nodesEnd = NODES + ast.size();
+    header.symbols = (header.nodesEnd + alignof(CacheSymbol) - 1) & ~(alignof(CacheSymbol) - 1);
+    header.names = header.symbols + symbols.size() * sizeof(CacheSymbol);
+    header.fixups = (header.names + names.size() + alignof(uint32_t) - 1) & ~(alignof(uint32_t) - 1);
+    header.size = header.fixups + fixups.size() * sizeof(uint32_t);
+    header.symbolCount = symbols.size();
+    header.fixupCount = fixups.size();
+    header.file = file;
+    if (header.size > Region::DEFAULT_RESERVE)
+    {
+      return false;
+    }
+
+    // Write to a file of our own and rename it, so readers never see half of one
+    std::string temp = m_dir + "/.XXXXXX";
+    int fd = mkstemp(temp.data());
+    if (fd < 0)
+    {
+      return false;
+    }
+    // mkstemp only lets us read it: other users of the cache should too
+    fchmod(fd, 0644);
+    char padding[NODES] = {};
+    std::memcpy(padding, &header, sizeof(header));
+    bool written = WriteAll(fd, padding, NODES) && WriteAll(fd, ast.data(), ast.size()) &&
+      WriteAll(fd, padding + sizeof(header), header.symbols - header.nodesEnd) &&
+      WriteAll(fd, symbols.data(), symbols.size() * sizeof(CacheSymbol)) &&
+      WriteAll(fd, names.data(), names.size()) &&
+      WriteAll(fd, padding + sizeof(header), header.fixups - header.names - names.size()) &&
+      WriteAll(fd, fixups.data(), fixups.size() * sizeof(uint32_t));
+    written = close(fd) == 0 && written && rename(temp.c_str(), path(header.key).c_str()) == 0;
+    if (!written)
+    {
+      unlink(temp.c_str());
+    }
+    return written;
+  }
+
+  AST ParseCache::parse(std::string_view source, FileID file, Diagnostics* diags, bool lazy) const
+  {
+    auto settings = Parser::Settings(Parser::DEFAULT_MAX_DEPTH, lazy);
+    if (auto cached = load(source, file, settings))
+    {
+      return std::move(*cached);
+    }
+
+    size_t errors = diags ? diags->size() : 0;
+    auto tokens = TokenStream::Tokenize(source, file, diags);
+    Parser parser(tokens, diags);
+    parser.setLazyBodies(lazy);
+    auto ast = parser();
+    if (!diags || diags->size() == errors)
+    {
+      store(source, ast, settings);
+    }
+    return ast;
+  }
+
+} // namespace leor
@@ -0,0 +1,60 @@
+#pragma once
+
+#ifndef LEOR_PARSECACHE_H
+#define LEOR_PARSECACHE_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "Diagnostics/Diagnostics.h"
+#include "Parser/AST.h"
+
+namespace leor
+{
+
+  // Class ParseCache - A directory of the trees of sources parsed before
+  // A tree is stored under a hash of its source, the parser settings and the layout of
+  // the nodes, as the bytes of its region: its nodes only point at each other by
+  // offset, so it's loaded by mapping the file, with no node decoded on the way in.
+  // Only symbols are process-local; the file lists where they are, so they can be
+  // renumbered when this process interned their names with other ids. The files are
+  // trusted to be ones this cache wrote: only their headers are checked.
+  class ParseCache
+  {
+  public:
+    static constexpr uint32_t FORMAT = 3;
+
+  private:
+    std::string m_dir;
+
+  public:
+    // The directory is created if it doesn't exist
+    explicit ParseCache(std::string dir);
+
+    // Tree of source as parsed with the given settings, if it's in the cache
+    // Its positions are in file. A tree with skipped bodies needs the tokens of source
+    // to parse them, as any other.
+    std::optional<AST> load(std::string_view source, FileID file, uint64_t settings) const;
+
+    // Store the tree parsed from source with the given settings, which must have had
+    // no errors; returns false if it couldn't be written
+    bool store(std::string_view source, const AST& ast, uint64_t settings) const;
+
+    // Tree of source through the cache: it's only lexed and parsed on a miss, and
+    // stored then unless there were errors
+    AST parse(std::string_view source, FileID file, Diagnostics* diags = nullptr, bool lazy = false) const;
+
+    // Hash of a whole source, 8 bytes at a time in four independent lanes
+    static uint64_t Hash(std::string_view data, uint64_t seed = 0);
+
+  private:
+    // What a tree is stored under: the hash of its source, seeded by what else shapes it
+    static uint64_t Key(std::string_view source, uint64_t settings);
+    std::string path(uint64_t key) const;
+  };
+
+} // namespace leor
+
+#endif //LEOR_PARSECACHE_H
@@ -1,145 +1,262 @@
 #include "Parser/Parser.h"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
 namespace leor
 {
 
-  Token Parser::IsPunc(const std::string& c)
+  struct Parser::Pipeline
+  {
+    TokenQueue queue;
+    Lexer lexer;           // Also keeps the decoded text of the tokens
+    Diagnostics lexed;     // Reported by the lexer thread
+    Diagnostics parsed;    // Reported by the parser meanwhile
+    Diagnostics* sink;     // Where they all go in the end
+    std::exception_ptr error;
+    std::thread thread;
+
+    Pipeline(std::string_view buffer, FileID file, size_t capacity, Diagnostics* sink)
+      : queue(capacity), lexer(buffer, file, &lexed), sink(sink)
+    { }
+  };
+
+  namespace
+  {
+
+    // Class ScopeExit - Calls a function when leaving the scope, returning or throwing
+    template <typename F>
+    class ScopeExit
+    {
+    private:
+      F m_f;
+
+    public:
+      explicit ScopeExit(F f) : m_f(std::move(f)) { }
+      ScopeExit(const ScopeExit&) = delete;
+      ScopeExit& operator=(const ScopeExit&) = delete;
+      ~ScopeExit() { m_f(); }
+    };
+
+  } // namespace
+
+  Token Parser::peek()
+  {
+    if (m_index >= m_tokens->size())
+    {
+      pull();
+    }
+    return (*m_tokens)[m_index];
+  }
+
+  Token Parser::get()
+  {
+    auto tok = peek();
+    if (!tok.isEOB())
+    {
+      m_index++;
+    }
+    return tok;
+  }
+
+  bool Parser::eof()
   {
-    auto tok = m_lexer.peek();
-    if (tok.type == Token::Type::PUNC && (c.empty() || tok.value == c))
+    return peek().isEOB();
+  }
+
+  void Parser::pull()
+  {
+    // Batches keep the per-token overhead of the pull path low
+    constexpr size_t BATCH = 256;
+    if (m_pipeline)
+    {
+      Token batch[BATCH];
+      size_t count = m_pipeline->queue.pop(batch, BATCH);
+      for (size_t i = 0; i < count; i++)
+      {
+        m_owned.push(batch[i]);
+      }
+      return;
+    }
+    for (size_t i = 0; i < BATCH; i++)
+    {
+      auto tok = m_lexer->rdNext();
+      m_owned.push(tok);
+      if (tok.isEOB())
+      {
+        break;
+      }
+    }
+  }
+
+  LineCol Parser::lineCol(const SourceLoc& loc) const
+  {
+    return m_lexer ? m_lexer->lineCol(loc) : m_tokens->lineCol(loc);
+  }
+
+  size_t Parser::MatchBrace(size_t begin)
+  {
+    size_t depth = 0;
+    for (size_t i = begin;; i++)
+    {
+      if (i >= m_tokens->size())
+      {
+        pull();
+      }
+      auto type = m_tokens->type(i);
+      if (type == Token::Type::EOB)
+      {
+        return SIZE_MAX;
+      }
+      if (type == Token::Type::PUNC)
+      {
+        auto op = m_tokens->payload(i).op;
+        if (op == Op::LBRACE)
+        {
+          depth++;
+        }
+        else if (op == Op::RBRACE && --depth == 0)
+        {
+          return i + 1;
+        }
+      }
+    }
+  }
+
+  void Parser::Error(DiagCode code, const SourceLoc& loc, std::string_view arg)
+  {
+    if (!m_diags)
+    {
+      throw std::runtime_error(Diagnostic{ code, loc, lineCol(loc), std::string(arg) }.toString());
+    }
+    // Whatever goes wrong until the parser is back on track is a consequence of this error
+    if (!m_panic)
+    {
+      m_diags->report(Diagnostic{ code, loc, lineCol(loc), std::string(arg) });
+      m_panic = true;
+    }
+  }
+
+  bool Parser::Recover(std::string_view sep, std::string_view end)
+  {
+    size_t depth = 0;
+    for (auto tok = peek(); !tok.isEOB(); tok = peek())
+    {
+      if (tok.type == Token::Type::PUNC)
+      {
+        auto c = tok.value()[0];
+        if (depth == 0)
+        {
+          if (tok.value() == sep || tok.value() == end)
+          {
+            m_panic = false;
+            return true;
+          }
+          if (c == ';' || c == '}')
+          {
+            return false;
+          }
+        }
+        if (c == '(' || c == '[' || c == '{')
+        {
+          depth++;
+        }
+        else if ((c == ')' || c == ']' || c == '}') && depth > 0)
+        {
+          depth--;
+        }
+      }
+      get();
+    }
+    return false;
+  }
+
+  Token Parser::IsPunc(std::string_view c)
+  {
+    auto tok = peek();
+    if (tok.type == Token::Type::PUNC && (c.empty() || tok.value() == c))
     {
       return tok;
     }
     return Token();
   }
 
-  Token Parser::IsOp(const std::string& c)
+  Token Parser::IsOp(std::string_view c)
   {
-    auto tok = m_lexer.peek();
-    if (tok.type == Token::Type::OP && (c.empty() || tok.value == c))
+    auto tok = peek();
+    if (tok.type == Token::Type::OP && (c.empty() || tok.value() == c))
     {
       return tok;
     }
     return Token();
   }
 
-  Token Parser::IsKeyword(const std::string& c)
+  Token Parser::IsKeyword(Keyword c)
   {
-    auto tok = m_lexer.peek();
-    if (tok.type == Token::Type::KEYWORD && (c.empty() || tok.value == c))
+    auto tok = peek();
+    if (tok.type == Token::Type::KEYWORD && (c == Keyword::NONE || tok.payload.keyword == c))
     {
       return tok;
     }
     return Token();
   }
 
-  void Parser::SkipPunc(const std::string& c)
+  void Parser::SkipPunc(std::string_view c)
   {
     auto tok = IsPunc(c);
     if (tok.type == Token::Type::PUNC)
     {
-      m_lexer.get();
+      get();
     }
     else
     {
-      auto [row, col] = tok.pos;
-      std::stringstream ss;
-      ss << "Error:" << row << ":" << col << ": Expected punctuation: " << c;
-      throw std::runtime_error(ss.str());
+      Error(DiagCode::EXPECTED_PUNC, peek().pos, c);
     }
   }
 
-  void Parser::SkipOp(const std::string& c)
+  void Parser::SkipOp(std::string_view c)
   {
     auto tok = IsOp(c);
     if (tok.type == Token::Type::OP)
     {
-      m_lexer.get();
+      get();
     }
     else
     {
-      auto [row, col] = tok.pos;
-      std::stringstream ss;
-      ss << "Error:" << row << ":" << col << ": Expected operator: " << c;
-      throw std::runtime_error(ss.str());
+      Error(DiagCode::EXPECTED_OP, peek().pos, c);
     }
   }
 
-  void Parser::SkipKeyword(const std::string& c)
+  void Parser::SkipKeyword(Keyword c)
   {
     auto tok = IsKeyword(c);
     if (tok.type == Token::Type::KEYWORD)
     {
-      m_lexer.get();
+      get();
     }
     else
     {
-      auto [row, col] = tok.pos;
-      std::stringstream ss;
-      ss << "Error:" << row << ":" << col << ": Expected keyword: " << c;
-      throw std::runtime_error(ss.str());
+      Error(DiagCode::EXPECTED_KEYWORD, peek().pos, Keywords::name(c));
     }
   }
 
-  AST Parser::MaybeBinary(AST lhs, uint64_t myPrec)
-  {
-    auto tok = IsOp();
-    if (!!tok)
-    {
-      auto hisPrec = OP_PRECEDENCE.at(tok.value);
-      if (hisPrec > myPrec)
-      {
-        auto pos = m_lexer.get().pos;
-        return MaybeBinary(
-          (
-            AST::Binary(
-              tok.value,
-              std::move(lhs),
-              MaybeBinary(ParseAtom(), hisPrec),
-              pos
-            )
-          ), myPrec
-        );
-      }
-    }
-    return lhs;
-  }
-
-  AST Parser::MaybeCall(std::function<AST()> f)
-  {
-    auto expr = f();
-    return !!IsPunc("(") ? ParseCall(std::move(expr)) : std::move(expr);
-  }
-
-  AST Parser::ParseCall(AST func)
-  {
-    auto pos = m_lexer.peek().pos;
-    return (
-      AST::Call(
-        std::move(func),
-        Delimited(
-          "(",
-          ")",
-          ",",
-          std::bind(&Parser::ParseExpression, this)
-        ),
-        pos
-      )
-    );
-  }
-
-  std::vector<AST> Parser::Delimited(
-    const std::string& beg,
-    const std::string& end,
-    const std::string& sep,
-    std::function<AST()> parser
+  template <typename F>
+  std::span<RelPtr<Node>> Parser::Delimited(
+    std::string_view beg,
+    std::string_view end,
+    std::string_view sep,
+    F&& parser
   ) {
 
-    std::vector<AST> res;
+    size_t mark = m_items.size();
     bool first = true;
 
     SkipPunc(beg);
-    while (!m_lexer.eof())
+    while (!m_panic && !eof())
     {
       // If the first token is the end token, return
       if (!!IsPunc(end))
@@ -163,178 +280,932 @@ namespace leor
         break;
       }
       
-      res.push_back(parser());
+      if (!m_panic)
+      {
+        auto item = parser();
+        if (item)
+        {
+          m_items.push_back(item);
+        }
+      }
+
+      // Skip what's left of a broken element and go on with the next one
+      if (m_panic && !Recover(sep, end))
+      {
+        break;
+      }
     }
     SkipPunc(end);
-    return res;
+
+    auto list = m_ast.List(std::span<Node* const>(m_items).subspan(mark));
+    m_items.resize(mark);
+    return list;
+  }
+
+  Node* Parser::ParseCall(Node* func)
+  {
+    auto pos = peek().pos;
+    auto args = Delimited(
+      "(",
+      ")",
+      ",",
+      [this]() { return ParseExpression(); }
+    );
+    return m_ast.Call(func, args, pos);
   }
 
-  AST Parser::ParseFunction()
+  Node* Parser::ParseFunction()
   {
-    auto pos = m_lexer.peek().pos;
+    auto pos = peek().pos;
 
-    SkipKeyword("def");
+    SkipKeyword(Keyword::DEF);
     auto name = ParseVarname();
     auto args = Delimited(
       "(",
       ")",
       ",",
-      std::bind(&Parser::ParseExpression, this) // TODO: ParseVar
+      [this]() { return ParseExpression(); } // TODO: ParseVar
     );
     SkipOp("->");
     auto type = ParseVarname();
+
+    if (m_lazy && !m_panic && !!IsPunc("{"))
+    {
+      // The block can only be skipped if it's the whole body: an operator after it
+      // would take the block as its operand
+      size_t begin = m_index;
+      size_t end = MatchBrace(begin);
+      m_index = end != SIZE_MAX ? end : begin;
+      auto after = peek();
+      auto& binding = Operators::info(after.type == Token::Type::OP || after.type == Token::Type::PUNC ? after.payload.op : Op::NONE);
+      if (end != SIZE_MAX && !binding.infix && !binding.postfix)
+      {
+        auto function = m_ast.Function(name, args, nullptr, type, pos);
+        function->bodyBegin = m_tokens->offset(begin);
+        function->bodyEnd = m_tokens->offset(end - 1) + 1;
+        function->depth = static_cast<uint32_t>(m_depth);
+        return function;
+      }
+      m_unskipped = std::min(m_unskipped, m_tokens->offset(begin));
+      m_index = begin;
+    }
     auto body = ParseExpression();
 
-    return (
-      AST::Function(
-        name,
-        std::move(args),
-        std::move(body),
-        type,
-        pos
-      )
-    );
+    return m_ast.Function(name, args, body, type, pos);
   }
 
-  AST Parser::ParseVariable()
+  Node* Parser::ParseVariable()
   {
-    bool isConst = !!IsKeyword("const");
-    m_lexer.get();
+    auto pos = peek().pos;
+    bool isConst = !!IsKeyword(Keyword::CONST);
+    get();
 
     auto name = ParseVarname();
     SkipOp(":");
     auto type = ParseVarname();
 
-    auto value = AST::None();
+    Node* value = nullptr;
     if (!!IsOp("="))
     {
-      m_lexer.get();
+      get();
       value = ParseExpression();
     }
 
-    return AST::Variable(name, type, value, isConst);
+    return m_ast.Variable(name, type, value, isConst, pos);
   }
 
-  AST Parser::ParseBool()
+  Node* Parser::ParseBool()
   {
-    auto pos = m_lexer.peek().pos;
-    return (
-      AST::Bool(
-        m_lexer.get().value == "true",
-        pos
-      )
-    );
+    auto pos = peek().pos;
+    return m_ast.Bool(get().payload.keyword == Keyword::TRUE, pos);
   }
 
-  AST Parser::ParseProg()
+  Node* Parser::ParseProg()
   {
-    auto pos = m_lexer.peek().pos;
-    auto prog = Delimited("{", "}", ";", std::bind(&Parser::ParseExpression, this));
-    return (
-      AST::Prog(
-        std::move(prog),
-        pos
-      )
-    );
+    auto pos = peek().pos;
+    auto depth = m_depth;
+    auto prog = Delimited("{", "}", ";", [this]() { return ParseExpression(); });
+    auto node = m_ast.Prog(prog, pos);
+
+    // Failing to take the '}' would have left the parser panicking, and so would
+    // have starting out panicking, with the elements skipped
+    if (!m_panic)
+    {
+      node->end = m_tokens->offset(m_index - 1) + m_tokens->length(m_index - 1);
+      node->depth = static_cast<uint32_t>(depth);
+    }
+    return node;
   }
 
-  std::string Parser::ParseVarname()
+  Node* Parser::ParseReturn()
   {
-    auto name = m_lexer.get();
+    auto pos = get().pos;
+
+    // A bare return is followed by the end of the statement
+    Node* value = nullptr;
+    if (!IsPunc(";") && !IsPunc("}"))
+    {
+      value = ParseExpression();
+    }
+    return m_ast.Return(value, pos);
+  }
+
+  Symbol Parser::ParseVarname()
+  {
+    auto name = peek();
     if (name.type != Token::Type::VAR)
     {
-      auto [row, col] = name.pos;
-      std::stringstream ss;
-      ss << "Error:" << row << ":" << col << ": Expected variable name";
-      throw std::runtime_error(ss.str());
+      Error(DiagCode::EXPECTED_VARNAME, name.pos);
+      return Symbol{ 0 };
     }
-    return name.value;
+    get();
+    return name.payload.symbol;
   }
 
-  AST Parser::ParseAtom()
+  Node* Parser::ParseAtom()
   {
-    return MaybeCall([this]() -> AST {
-      if (!!IsPunc("("))
+    if (!!IsPunc("{"))
+    {
+      return ParseProg();
+    }
+
+    if (!!IsKeyword(Keyword::TRUE) || !!IsKeyword(Keyword::FALSE))
+    {
+      return ParseBool();
+    }
+
+    if (!!IsKeyword(Keyword::DEF))
+    {
+      return ParseFunction();
+    }
+
+    if (!!IsKeyword(Keyword::CONST) || !!IsKeyword(Keyword::MUT))
+    {
+      return ParseVariable();
+    }
+
+    if (!!IsKeyword(Keyword::RETURN))
+    {
+      return ParseReturn();
+    }
+
+    auto tok = peek();
+    switch (tok.type)
+    {
+      case Token::Type::INT:
+      case Token::Type::FLOAT:
+      case Token::Type::STRING:
+      case Token::Type::CHAR:
+      case Token::Type::VAR:
+        get();
+        break;
+      default:
+        // Leave the token to the recovery: it may be the ';' or '}' it stops at
+        Error(DiagCode::UNEXPECTED_TOKEN, tok.pos, tok.value());
+        return nullptr;
+    }
+
+    if (tok.type == Token::Type::INT)
+    {
+      return m_ast.Int(tok.payload.integer, tok.pos);
+    }
+    if (tok.type == Token::Type::FLOAT)
+    {
+      return m_ast.Float(tok.payload.real, tok.pos);
+    }
+    if (tok.type == Token::Type::STRING)
+    {
+      return m_ast.String(tok.value(), tok.pos);
+    }
+    if (tok.type == Token::Type::CHAR)
+    {
+      // A literal that isn't one character was reported by the lexer: it stands for its
+      // first byte, or '\0' if it's empty
+      auto value = DecodeChar(tok.value());
+      if (value == INVALID_CHAR)
       {
-        m_lexer.get();
-        auto expr = ParseExpression();
-        SkipPunc(")");
-        return expr;
+        value = tok.value().empty() ? 0 : static_cast<uint8_t>(tok.value()[0]);
       }
+      return m_ast.Char(value, tok.pos);
+    }
+    if (tok.type == Token::Type::VAR)
+    {
+      return m_ast.Var(tok.payload.symbol, tok.pos);
+    }
+    return nullptr;
+  }
+
+  Node* Parser::ParseExpression()
+  {
+    if (m_depth >= m_maxDepth)
+    {
+      Error(DiagCode::NESTING_TOO_DEEP, peek().pos, std::to_string(m_maxDepth));
+      return nullptr;
+    }
+    m_depth++;
 
-      if (!!IsPunc("{"))
+    size_t base = m_frames.size();
+    uint8_t power = 0;
+    Node* lhs = nullptr;
+    bool operand = true;
+    while (true)
+    {
+      if (operand)
       {
-        return ParseProg();
+        // Prefix operators and parentheses wait on the stack for what follows them
+        auto tok = peek();
+        auto prefix = tok.type == Token::Type::OP ? Operators::info(tok.payload.op).prefix : 0;
+        if (prefix)
+        {
+          get();
+          m_frames.push_back(Frame{ Frame::Kind::PREFIX, tok.payload.op, power, nullptr, tok.pos });
+          power = prefix;
+          continue;
+        }
+        if (tok.type == Token::Type::PUNC && tok.payload.op == Op::LPAREN)
+        {
+          if (m_depth >= m_maxDepth)
+          {
+            Error(DiagCode::NESTING_TOO_DEEP, tok.pos, std::to_string(m_maxDepth));
+            lhs = nullptr;
+          }
+          else
+          {
+            get();
+            m_depth++;
+            m_frames.push_back(Frame{ Frame::Kind::GROUP, Op::LPAREN, power, nullptr, tok.pos });
+            power = 0;
+            continue;
+          }
+        }
+        else
+        {
+          lhs = ParseAtom();
+        }
+        operand = false;
       }
 
-      if (!!IsKeyword("true") || !!IsKeyword("false"))
+      if (!m_panic)
       {
-        return ParseBool();
+        auto tok = peek();
+        auto& binding = Operators::info(tok.type == Token::Type::OP || tok.type == Token::Type::PUNC ? tok.payload.op : Op::NONE);
+
+        // The only postfix operator is a call
+        if (binding.postfix && binding.postfix >= power)
+        {
+          lhs = ParseCall(lhs);
+          continue;
+        }
+
+        // Operators that aren't binary end the expression
+        if (binding.infix && binding.infix >= power)
+        {
+          get();
+          m_frames.push_back(Frame{ Frame::Kind::BINARY, tok.payload.op, power, lhs, tok.pos });
+          power = Operators::rightPower(tok.payload.op);
+          operand = true;
+          continue;
+        }
       }
 
-      if (!!IsKeyword("def"))
+      // Nothing binds to lhs at this power: it completes the innermost frame
+      if (m_frames.size() == base)
       {
-        return ParseFunction();
+        break;
       }
-
-      if (!!IsKeyword("const") || !!IsKeyword("mut"))
+      auto frame = m_frames.back();
+      m_frames.pop_back();
+      power = frame.power;
+      switch (frame.kind)
       {
-        return ParseVariable();
+        case Frame::Kind::BINARY:
+          lhs = m_ast.Binary(frame.op, frame.lhs, lhs, frame.pos);
+          break;
+        case Frame::Kind::PREFIX:
+          lhs = m_ast.Unary(frame.op, lhs, frame.pos);
+          break;
+        case Frame::Kind::GROUP:
+          SkipPunc(")");
+          m_depth--;
+          break;
       }
+    }
 
-      auto tok = m_lexer.get();
-      if (tok.type == Token::Type::INT)
+    m_depth--;
+    return lhs;
+  }
+
+  void Parser::ParseItems(size_t end)
+  {
+    while (m_index < end && !eof())
+    {
+      auto start = peek().pos.offset;
+      auto item = ParseExpression();
+      if (item)
       {
-        return AST::Int(std::stoi(tok.value));
+        m_items.push_back(item);
+        m_starts.push_back(start);
       }
-      if (tok.type == Token::Type::FLOAT)
+      if (m_panic)
       {
-        return AST::Float(std::stof(tok.value));
+        // At the top level, a '}' closes nothing and is skipped as well
+        while (!Recover(";", "") && !eof())
+        {
+          get();
+        }
       }
-      if (tok.type == Token::Type::STRING)
+      SkipPunc(";");
+    }
+  }
+
+  ProgNode* Parser::Toplevel(size_t mark, const SourceLoc& pos)
+  {
+    auto prog = m_ast.Prog(m_ast.List(std::span<Node* const>(m_items).subspan(mark)), pos);
+    prog->starts = m_ast.Offsets(std::span<const uint32_t>(m_starts).subspan(mark));
+    prog->unskipped = m_unskipped;
+    m_items.resize(mark);
+    m_starts.resize(mark);
+    return prog;
+  }
+
+  ProgNode* Parser::ParseToplevel()
+  {
+    auto pos = peek().pos;
+    size_t mark = m_items.size();
+    try
+    {
+      ParseItems();
+    }
+    catch (const RegionFull&)
+    {
+      return TreeTooLarge(mark, pos);
+    }
+    return Toplevel(mark, pos);
+  }
+
+  ProgNode* Parser::TreeTooLarge(size_t mark, const SourceLoc& pos)
+  {
+    // Nothing parsed so far is kept, and the region's memory goes with it
+    auto loc = peek().pos;
+    m_items.resize(mark);
+    m_starts.resize(mark);
+    m_frames.clear();
+    m_depth = 0;
+    m_unskipped = UINT32_MAX;
+    m_ast = AST();
+    m_panic = false;
+    Error(DiagCode::TREE_TOO_LARGE, loc, std::to_string(Region::DEFAULT_RESERVE >> 30) + " GiB");
+    return Toplevel(mark, pos);
+  }
+
+  void Parser::Release()
+  {
+    m_ast.reset();
+    if (m_lexer)
+    {
+      // The tokens pulled ahead take their text along to the arena the lexer goes on
+      // with, so the one it used so far holds nothing anymore
+      m_owned.discard(m_index, m_spare);
+      m_lexer->swapArena(m_spare);
+      m_spare.reset();
+      m_index = 0;
+    }
+  }
+
+  Parser::Parser(std::string_view buffer, FileID file, Diagnostics* diags)
+    : m_owned(TokenStream::Tokenize(buffer, file, diags)), m_tokens(&m_owned), m_index(0), m_diags(diags), m_panic(false),
+      m_depth(0), m_maxDepth(DEFAULT_MAX_DEPTH), m_lazy(false), m_unskipped(UINT32_MAX)
+  { }
+
+  Parser::Parser(const TokenStream& tokens, Diagnostics* diags)
+    : m_tokens(&tokens), m_index(0), m_diags(diags), m_panic(false),
+      m_depth(0), m_maxDepth(DEFAULT_MAX_DEPTH), m_lazy(false), m_unskipped(UINT32_MAX)
+  { }
+
+  Parser::Parser(PageRing& ring, FileID file, Diagnostics* diags)
+    : m_lexer(new Lexer(ring, file, diags)), m_owned(TokenStream::Streamed(file)), m_tokens(&m_owned), m_index(0),
+      m_diags(diags), m_panic(false), m_depth(0), m_maxDepth(DEFAULT_MAX_DEPTH), m_lazy(false), m_unskipped(UINT32_MAX)
+  { }
+
+  Parser::Parser(std::string_view buffer, Pipelined pipelined, FileID file, Diagnostics* diags)
+    : m_pipeline(new Pipeline(buffer, file, pipelined.capacity, diags)), m_owned(buffer, file), m_tokens(&m_owned),
+      m_index(0), m_diags(&m_pipeline->parsed), m_panic(false), m_depth(0), m_maxDepth(DEFAULT_MAX_DEPTH), m_lazy(false), m_unskipped(UINT32_MAX)
+  {
+    m_pipeline->thread = std::thread([pipeline = m_pipeline.get()]
+    {
+      auto& queue = pipeline->queue;
+      try
       {
-        return AST::String(std::move(tok.value));
+        for (auto tok = pipeline->lexer.rdNext(); queue.push(tok) && !tok.isEOB(); tok = pipeline->lexer.rdNext())
+        { }
       }
-      if (tok.type == Token::Type::CHAR)
+      catch (...)
+      {
+        // The parser takes it from here once it reaches the end
+        pipeline->error = std::current_exception();
+        queue.push(Token(Token::Type::EOB, ""));
+      }
+      queue.flush();
+    });
+  }
+
+  Parser::~Parser()
+  {
+    if (m_pipeline && m_pipeline->thread.joinable())
+    {
+      m_pipeline->queue.close();
+      m_pipeline->thread.join();
+    }
+  }
+
+  void Parser::Finish()
+  {
+    if (!m_pipeline || !m_pipeline->thread.joinable())
+    {
+      return;
+    }
+    auto& pipeline = *m_pipeline;
+    pipeline.queue.close();
+    pipeline.thread.join();
+    m_diags = pipeline.sink;
+    if (pipeline.error)
+    {
+      std::rethrow_exception(pipeline.error);
+    }
+
+    if (pipeline.sink)
+    {
+      for (auto& diag : pipeline.lexed.all())
       {
-        return AST::Char(tok.value.at(0));
+        pipeline.sink->report(diag);
       }
-      if (tok.type == Token::Type::VAR)
+      for (auto& diag : pipeline.parsed.all())
       {
-        return AST::Var(tok.value);
+        pipeline.sink->report(diag);
       }
+    }
+    else if (!pipeline.lexed.empty() || !pipeline.parsed.empty())
+    {
+      auto& first = pipeline.lexed.empty() ? pipeline.parsed : pipeline.lexed;
+      throw std::runtime_error(first.all().front().toString());
+    }
+  }
 
-      throw std::runtime_error("Unexpected token");
-    });
+  AST Parser::operator()()
+  {
+    m_ast.setRoot(ParseToplevel());
+    Finish();
+    return std::move(m_ast);
   }
 
-  AST Parser::ParseExpression()
+  Node* Parser::ParseBody(AST& ast, FunctionNode* function)
   {
-    return MaybeCall([this]() -> AST {
-      auto lhs = ParseAtom();
-      return MaybeBinary(std::move(lhs), 0);
+    if (!function->lazy())
+    {
+      return function->body;
+    }
+
+    // A tree from other tokens, or from these before an edit it wasn't reparsed for, may
+    // have its body start anywhere in them, or past their end
+    size_t begin = m_tokens->find(function->bodyBegin);
+    if (begin == TokenStream::npos || m_tokens->type(begin) != Token::Type::PUNC ||
+        m_tokens->payload(begin).op != Op::LBRACE)
+    {
+      throw std::runtime_error("Error: The function body to parse is not in the parser's tokens");
+    }
+
+    // Parse into the tree the function lives in, at the depth it would have been parsed
+    // at, then hand it back and carry on as before: also when an error is thrown, and
+    // in the middle of ParseEach, whose tree is kept aside meanwhile
+    std::swap(m_ast, ast);
+    ScopeExit restore([this, &ast, index = m_index, depth = m_depth, panic = m_panic, unskipped = m_unskipped,
+      items = m_items.size(), frames = m_frames.size()]
+    {
+      m_index = index;
+      m_depth = depth;
+      m_panic = panic;
+      m_unskipped = unskipped;
+      m_items.resize(items);
+      m_frames.resize(frames);
+      std::swap(m_ast, ast);
     });
+    m_index = begin;
+    m_depth = function->depth;
+    m_panic = false;
+    m_unskipped = UINT32_MAX;
+    auto body = ParseExpression();
+    function->body = body;
+    function->bodyBegin = function->bodyEnd = 0;
+    if (auto root = m_ast.root())
+    {
+      root->unskipped = std::min(root->unskipped, m_unskipped);
+    }
+    return body;
   }
 
-  AST Parser::ParseToplevel()
+  AST Parser::ParseParallel(size_t threads, size_t minChunk)
   {
-    auto pos = m_lexer.peek().pos;
-    std::vector<AST> prog;
-    while (!m_lexer.eof())
+    if (threads == 0)
     {
-      prog.push_back(ParseExpression());
-      SkipPunc(";");
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (m_lexer || m_pipeline || threads == 1 || m_tokens->size() < 2 * minChunk)
+    {
+      return (*this)();
+    }
+
+    // Cut the tokens after every ';' outside of brackets, into chunks of at least
+    // minChunk tokens, and several per thread so that stealing can even out the load
+    size_t size = m_tokens->size();
+    size_t target = std::max(minChunk, size / (threads * 8));
+    std::vector<size_t> starts{ m_index };
+    size_t depth = 0;
+    for (size_t i = m_index; i + 1 < size; i++)
+    {
+      if (m_tokens->type(i) != Token::Type::PUNC)
+      {
+        continue;
+      }
+      switch (m_tokens->payload(i).op)
+      {
+        case Op::LPAREN: case Op::LBRACKET: case Op::LBRACE:
+          depth++;
+          break;
+        case Op::RPAREN: case Op::RBRACKET: case Op::RBRACE:
+          depth -= depth > 0;
+          break;
+        case Op::SEMICOLON:
+          if (depth == 0 && i + 1 - starts.back() >= target)
+          {
+            starts.push_back(i + 1);
+          }
+          break;
+        default:
+          break;
+      }
+    }
+    size_t chunks = starts.size();
+    starts.push_back(size - 1); // The EOB token
+    threads = std::min(threads, chunks);
+    if (threads == 1)
+    {
+      return (*this)();
+    }
+
+    struct Chunk
+    {
+      std::vector<Node*> items;
+      std::vector<uint32_t> starts;
+      size_t worker = 0;
+      size_t begin = 0;     // The chunk's nodes, between two marks of the worker's tree
+      size_t end = 0;
+      bool complete = false; // Parsed without errors, ending exactly at the next chunk
+      uint32_t unskipped = UINT32_MAX;
+    };
+    std::vector<Chunk> parts(chunks);
+
+    // Every worker takes chunks from the front of its own range, and once that is
+    // empty steals from the back of the others'. A range is packed in one word as
+    // front << 32 | back, so both ends move with a single compare and swap.
+    std::vector<std::atomic<uint64_t>> ranges(threads);
+    for (size_t w = 0; w < threads; w++)
+    {
+      uint64_t front = chunks * w / threads;
+      uint64_t back = chunks * (w + 1) / threads;
+      ranges[w].store(front << 32 | back, std::memory_order_relaxed);
+    }
+    auto take = [&ranges](size_t w, bool steal) -> size_t
+    {
+      auto range = ranges[w].load(std::memory_order_relaxed);
+      while (true)
+      {
+        uint64_t front = range >> 32;
+        uint64_t back = range & 0xFFFFFFFF;
+        if (front >= back)
+        {
+          return SIZE_MAX;
+        }
+        auto next = steal ? front << 32 | (back - 1) : (front + 1) << 32 | back;
+        if (ranges[w].compare_exchange_weak(range, next, std::memory_order_relaxed))
+        {
+          return steal ? back - 1 : front;
+        }
+      }
+    };
+
+    // Errors are resolved to rows and columns through a line table built on first use:
+    // build it before the workers share it
+    lineCol(peek().pos);
+
+    std::vector<Diagnostics> speculative(threads);
+    std::vector<std::unique_ptr<Parser>> parsers;
+    for (size_t w = 0; w < threads; w++)
+    {
+      parsers.emplace_back(new Parser(*m_tokens, &speculative[w]));
+      parsers.back()->m_maxDepth = m_maxDepth;
+      parsers.back()->m_lazy = m_lazy;
+    }
+
+    auto work = [&](size_t w)
+    {
+      auto& parser = *parsers[w];
+      for (size_t victim = w; victim < w + threads;)
+      {
+        size_t i = take(victim % threads, victim != w);
+        if (i == SIZE_MAX)
+        {
+          victim++;
+          continue;
+        }
+
+        auto& part = parts[i];
+        parser.m_index = starts[i];
+        part.worker = w;
+        part.begin = parser.m_ast.mark();
+        try
+        {
+          parser.ParseItems(starts[i + 1]);
+          part.complete = speculative[w].empty() && parser.m_index == starts[i + 1];
+        }
+        catch (const RegionFull&)
+        {
+          // Left to the sequential parse, which reports it if the whole tree is too large
+          part.complete = false;
+        }
+        part.end = parser.m_ast.mark();
+        part.unskipped = parser.m_unskipped;
+        part.items.swap(parser.m_items);
+        part.starts.swap(parser.m_starts);
+
+        // A failed chunk leaves the parser in the middle of something: start afresh
+        speculative[w].clear();
+        parser.m_items.clear();
+        parser.m_starts.clear();
+        parser.m_frames.clear();
+        parser.m_panic = false;
+        parser.m_depth = 0;
+        parser.m_unskipped = UINT32_MAX;
+      }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t w = 1; w < threads; w++)
+    {
+      workers.emplace_back(work, w);
+    }
+    work(0);
+    for (auto& worker : workers)
+    {
+      worker.join();
     }
-    return (AST::Prog(std::move(prog), pos));
+
+    // Chunk starts are item starts, so up to the first broken chunk the sequential
+    // parser would have parsed the same items; from there on, it does the parsing
+    auto pos = peek().pos;
+    size_t mark = m_items.size();
+    try
+    {
+      for (size_t i = 0; i < chunks; i++)
+      {
+        auto& part = parts[i];
+        if (!part.complete)
+        {
+          m_index = starts[i];
+          ParseItems();
+          break;
+        }
+        auto shift = m_ast.Splice(parsers[part.worker]->m_ast, part.begin, part.end);
+        for (auto item : part.items)
+        {
+          m_items.push_back(reinterpret_cast<Node*>(reinterpret_cast<char*>(item) + shift));
+        }
+        m_starts.insert(m_starts.end(), part.starts.begin(), part.starts.end());
+        m_unskipped = std::min(m_unskipped, part.unskipped);
+      }
+    }
+    catch (const RegionFull&)
+    {
+      m_ast.setRoot(TreeTooLarge(mark, pos));
+      return std::move(m_ast);
+    }
+
+    m_ast.setRoot(Toplevel(mark, pos));
+    return std::move(m_ast);
   }
 
-  Parser::Parser(const std::string& buffer)
-    : m_lexer(buffer)
-  { }
+  TokenRange Parser::Reparse(AST& tree, const TextEdit& edit, const TokenRange& relexed)
+  {
+    // Errors are held back until the tree is updated, in case it's parsed from scratch
+    auto sink = m_diags;
+    Diagnostics held;
+    TokenRange range;
+    {
+      m_diags = sink ? &held : nullptr;
+      ScopeExit restore([this, sink] { m_diags = sink; });
+      try
+      {
+        range = ReparseTree(tree, edit, relexed);
+      }
+      catch (const RegionFull&)
+      {
+        // What the tree dropped still takes its room: start over in a new region
+        held.clear();
+        tree = AST();
+        m_index = 0;
+        m_depth = 0;
+        m_panic = false;
+        m_unskipped = UINT32_MAX;
+        m_ast = AST();
+        m_ast.setRoot(ParseToplevel());
+        tree = std::move(m_ast);
+        range = TokenRange{ 0, m_index };
+      }
+    }
+    for (auto& diag : held.all())
+    {
+      sink->report(diag);
+    }
 
-  AST Parser::operator()()
+    if (tree.dead() > tree.size() - tree.dead())
+    {
+      tree.compact();
+    }
+    return range;
+  }
+
+  TokenRange Parser::ReparseTree(AST& tree, const TextEdit& edit, const TokenRange& relexed)
   {
-    return ParseToplevel();
+    int64_t delta = int64_t(edit.inserted) - int64_t(edit.removed);
+    auto root = tree.root();
+    auto starts = root->starts.data();
+    size_t count = root->prog.size();
+
+    // The relexed tokens, in offsets of the old source; the rest of the tokens are
+    // the old ones, and parse the same way from the same state
+    uint32_t changeBegin = m_tokens->offset(relexed.begin);
+    uint32_t changeEnd = relexed.end < m_tokens->size() ? static_cast<uint32_t>(m_tokens->offset(relexed.end) - delta) : UINT32_MAX;
+
+    // The top-level item the change starts in
+    size_t item = std::upper_bound(starts, starts + count, changeBegin) - starts;
+    item -= item > 0;
+
+    // A lazy parse skips a body if its braces match and nothing binds to it after them,
+    // which reaches past the body: the first one it couldn't skip may be skippable after
+    // any later edit, so parse again from there
+    uint32_t unskipped = m_lazy ? root->unskipped : UINT32_MAX;
+    m_unskipped = UINT32_MAX;
+
+    // Whatever precedes a block is untouched, so it's reached in the same state as before.
+    // If it's still closed by the same '}', whatever follows is parsed as before too.
+    if (item < count && (item + 1 == count || starts[item + 1] >= changeEnd) && unskipped >= changeBegin)
+    {
+      // The innermost block around the change: they nest, so it's the one opening last
+      RelPtr<Node>* slot = nullptr;
+      std::vector<RelPtr<Node>*> stack{ &root->prog.data()[item] };
+      while (!stack.empty())
+      {
+        auto top = stack.back();
+        stack.pop_back();
+        auto node = top->get();
+        auto block = node->as<ProgNode>();
+        if (block && block->closed() && block->pos.offset < changeBegin && block->end - 1 >= changeEnd &&
+            (!slot || block->pos.offset > slot->get()->pos.offset))
+        {
+          slot = top;
+        }
+        auto function = node->as<FunctionNode>();
+        ForEachChild(node, [&](RelPtr<Node>& child)
+        {
+          // A skipped body is delimited by its braces alone, which an edit can change
+          if (!(m_lazy && function && &child == &function->body))
+          {
+            stack.push_back(&child);
+          }
+        });
+      }
+
+      if (slot && slot->get()->as<ProgNode>()->end <= unskipped)
+      {
+        auto block = slot->get()->as<ProgNode>();
+        auto sink = m_diags;
+        Diagnostics attempt;
+        m_diags = sink ? &attempt : nullptr;
+        m_ast = std::move(tree);
+        m_index = m_tokens->find(block->pos.offset);
+        m_depth = block->depth;
+        m_panic = false;
+        size_t begin = m_index;
+        ProgNode* fresh;
+        {
+          // The tree goes back to the caller even if an error is thrown
+          ScopeExit restore([this, &tree, sink, items = m_items.size(), frames = m_frames.size()]
+          {
+            m_diags = sink;
+            m_items.resize(items);
+            m_frames.resize(frames);
+            tree = std::move(m_ast);
+          });
+          fresh = static_cast<ProgNode*>(ParseProg());
+        }
+
+        if (fresh->closed() && fresh->end == block->end + delta && m_unskipped == UINT32_MAX)
+        {
+          for (auto& diag : attempt.all())
+          {
+            sink->report(diag);
+          }
+          for (size_t i = item; i < count; i++)
+          {
+            AST::Shift(root->prog[i], changeEnd, delta, block);
+          }
+          for (size_t i = item + 1; i < count; i++)
+          {
+            starts[i] += delta;
+          }
+          if (unskipped != UINT32_MAX)
+          {
+            root->unskipped = static_cast<uint32_t>(unskipped + delta);
+          }
+          tree.drop(AST::Bytes(block));
+          *slot = fresh;
+          return TokenRange{ begin, m_index };
+        }
+      }
+    }
+
+    // Parse the top level again from an item the old parse started cleanly, after a ';'
+    // and not after a body that may be skipped now
+    if (unskipped < changeBegin)
+    {
+      item = std::min<size_t>(item, std::upper_bound(starts, starts + count, unskipped) - starts - 1);
+    }
+    m_unskipped = UINT32_MAX;
+    auto isSemicolon = [this](size_t i)
+    {
+      return i > 0 && m_tokens->type(i - 1) == Token::Type::PUNC && m_tokens->payload(i - 1).op == Op::SEMICOLON;
+    };
+    while (item > 0 && !isSemicolon(m_tokens->find(starts[item])))
+    {
+      item--;
+    }
+
+    m_ast = std::move(tree);
+    size_t mark = m_items.size();
+    ScopeExit restore([this, &tree, mark, frames = m_frames.size()]
+    {
+      m_items.resize(mark);
+      m_starts.resize(mark);
+      m_frames.resize(frames);
+      tree = std::move(m_ast);
+    });
+    for (size_t i = 0; i < item; i++)
+    {
+      m_items.push_back(root->prog[i]);
+      m_starts.push_back(starts[i]);
+    }
+    m_index = item > 0 ? m_tokens->find(starts[item]) : 0;
+    m_depth = 0;
+    m_panic = false;
+    size_t begin = m_index;
+    auto pos = item > 0 ? root->pos : peek().pos;
+
+    // Until an old item starts right after a ';' that was taken, past the relexed tokens.
+    // Only the first body that wasn't skipped is known: past it, stop once another is found.
+    size_t reuse = count;
+    while (!eof())
+    {
+      if (m_index > relexed.end && !m_panic)
+      {
+        auto old = static_cast<uint32_t>(m_tokens->offset(m_index) - delta);
+        auto it = std::lower_bound(starts + item, starts + count, old);
+        if (it != starts + count && *it == old && (old <= unskipped || m_unskipped != UINT32_MAX))
+        {
+          reuse = it - starts;
+          break;
+        }
+      }
+      ParseItems(m_index + 1);
+    }
+    size_t end = m_index;
+    if (reuse < count && unskipped != UINT32_MAX && unskipped >= starts[reuse])
+    {
+      m_unskipped = std::min(m_unskipped, static_cast<uint32_t>(unskipped + delta));
+    }
+
+    for (size_t i = reuse; i < count; i++)
+    {
+      AST::Shift(root->prog[i], changeEnd, delta);
+      m_items.push_back(root->prog[i]);
+      m_starts.push_back(static_cast<uint32_t>(starts[i] + delta));
+    }
+    // The old top level goes, with the items parsed again
+    m_ast.drop(AST::Bytes(root, true));
+    for (size_t i = item; i < reuse; i++)
+    {
+      m_ast.drop(AST::Bytes(root->prog[i]));
+    }
+    m_ast.setRoot(Toplevel(mark, pos));
+    return TokenRange{ begin, end };
   }
   
 } // namespace leor
@@ -4,53 +4,216 @@
 #define LEOR_PARSER_H
 
 #include "Parser/AST.h"
+#include "Parser/Operators.h"
 #include "Lexer/Lexer.h"
-
-#include <functional>
+#include "Lexer/TokenQueue.h"
+#include "Lexer/TokenStream.h"
 
 namespace leor
 {
+  // Class Parser - A recursive descent parser over a TokenStream
+  // With a Diagnostics sink, errors are reported and the parser recovers at the next
+  // ';' or '}' so that one pass finds every error; without one, the first error throws.
+  // Operators and parentheses are parsed on an explicit stack; the constructs that
+  // still recurse, such as calls, blocks and statements, are bounded by a nesting limit.
   class Parser
   {
+  public:
+    static constexpr size_t DEFAULT_MAX_DEPTH = 256;
+    static constexpr size_t DEFAULT_MIN_CHUNK = 16 * 1024; // Tokens
+
   private:
-    Lexer m_lexer;
+    // Struct Frame - An operator or parenthesis waiting for its operand
+    struct Frame
+    {
+      enum class Kind : uint8_t
+      {
+        BINARY, PREFIX, GROUP
+      };
+
+      Kind kind;
+      Op op;
+      uint8_t power; // Binding power to restore once the frame is done
+      Node* lhs;
+      SourceLoc pos;
+    };
+
+    // Struct Pipeline - A lexer running ahead of the parser on a thread of its own
+    struct Pipeline;
 
-    Token IsPunc(const std::string& c = "");
-    Token IsOp(const std::string& c = "");
-    Token IsKeyword(const std::string& c = "");
+    std::unique_ptr<Lexer> m_lexer; // Pulls tokens from a streamed source as they're needed
+    std::unique_ptr<Pipeline> m_pipeline;
+    Arena m_spare;                  // Where the lexer keeps token text next, see Release
+    TokenStream m_owned;
+    const TokenStream* m_tokens;
+    size_t m_index;
+    Diagnostics* m_diags;
+    bool m_panic; // An error was reported and the parser hasn't recovered yet
+    AST m_ast;
+    std::vector<Node*> m_items; // Stack of the elements of the lists being parsed
+    std::vector<Frame> m_frames; // Stack of the operators of the expressions being parsed
+    std::vector<uint32_t> m_starts; // Where the top-level items in m_items start
+    size_t m_depth;
+    size_t m_maxDepth;
+    bool m_lazy; // Skip function bodies, to be parsed by ParseBody
+    uint32_t m_unskipped; // Offset of the first body m_lazy couldn't skip
 
-    void SkipPunc(const std::string& c);
-    void SkipOp(const std::string& c);
-    void SkipKeyword(const std::string& c);
+    // Get the current token
+    Token peek();
+    // Get the current token and advance to the next one
+    Token get();
+    // EOF check
+    bool eof();
+    // Lex more tokens of a streamed source
+    void pull();
 
-    AST MaybeBinary(AST lhs, uint64_t myPrec);
-    AST MaybeCall(std::function<AST()> f);
+    LineCol lineCol(const SourceLoc& loc) const;
 
-    AST ParseCall(AST func);
-    AST ParseFunction();
-    AST ParseVariable();
-    AST ParseBool();
-    AST ParseProg();
+    // Index of the token after the '}' matching the '{' at index begin, or SIZE_MAX
+    // if the source ends first. Nothing but braces is looked at.
+    size_t MatchBrace(size_t begin);
 
-    std::string ParseVarname();
-    AST ParseExpression();
-    AST ParseAtom();
+    // Report an error unless one is already being recovered from
+    void Error(DiagCode code, const SourceLoc& loc, std::string_view arg = "");
+    // Skip the rest of a broken list element, up to the separator or end of the list
+    // Returns false when a ';' or '}' belonging to an enclosing construct comes first.
+    bool Recover(std::string_view sep, std::string_view end);
 
-    AST ParseToplevel();
+    Token IsPunc(std::string_view c = "");
+    Token IsOp(std::string_view c = "");
+    Token IsKeyword(Keyword c = Keyword::NONE);
+
+    void SkipPunc(std::string_view c);
+    void SkipOp(std::string_view c);
+    void SkipKeyword(Keyword c);
+
+    Node* ParseCall(Node* func);
+    Node* ParseFunction();
+    Node* ParseVariable();
+    Node* ParseBool();
+    Node* ParseProg();
+    Node* ParseReturn();
+
+    Symbol ParseVarname();
+    // Parse operators around the atoms, Pratt style, without recursing
+    Node* ParseExpression();
+    Node* ParseAtom();
+
+    // Parse top-level items until the token at index end, or the end of the source
+    void ParseItems(size_t end = SIZE_MAX);
+    // Build the top level out of the items parsed since mark
+    ProgNode* Toplevel(size_t mark, const SourceLoc& pos);
+    ProgNode* ParseToplevel();
+    // Report a tree outgrowing its region, and give up on it for an empty top level
+    ProgNode* TreeTooLarge(size_t mark, const SourceLoc& pos);
+    // Let go of the nodes and consumed tokens of the items parsed so far
+    void Release();
+    // Wait for the lexer thread, and report what it found
+    void Finish();
+    // Reparse, within the region the tree has left
+    TokenRange ReparseTree(AST& tree, const TextEdit& edit, const TokenRange& relexed);
 
   private:
-    std::vector<AST> Delimited(
-      const std::string& beg,
-      const std::string& end,
-      const std::string& sep,
-      std::function<AST()> parser
+    // The elements are copied into the tree, and nodes failing to parse are left out
+    // The element parser is a template parameter, so the whole descent can be inlined.
+    template <typename F>
+    std::span<RelPtr<Node>> Delimited(
+      std::string_view beg,
+      std::string_view end,
+      std::string_view sep,
+      F&& parser
     );
     
   public:
-    Parser(const std::string& buffer);
+    // Struct Pipelined - Asks for the buffer to be lexed on a thread of its own
+    struct Pipelined
+    {
+      size_t capacity = TokenQueue::DEFAULT_CAPACITY; // Tokens the lexer may run ahead
+    };
+
+    // Tokenize the whole buffer up front, then parse
+    Parser(std::string_view buffer, FileID file = 0, Diagnostics* diags = nullptr);
+    // Parse a tokenized buffer, which must outlive the parser
+    Parser(const TokenStream& tokens, Diagnostics* diags = nullptr);
+    // Lex a streamed source as parsing goes
+    Parser(PageRing& ring, FileID file = 0, Diagnostics* diags = nullptr);
+    // Lex the buffer on another thread while parsing, taking tokens from a TokenQueue
+    // The errors are reported once parsing is done, the lexer's first, as if the whole
+    // buffer had been tokenized up front; without diagnostics, the first one throws then.
+    Parser(std::string_view buffer, Pipelined pipelined, FileID file = 0, Diagnostics* diags = nullptr);
 
+    Parser(const Parser&) = delete;
+    Parser& operator=(const Parser&) = delete;
+    ~Parser();
+
+    // Nesting deeper than this is reported rather than risking the stack
+    void setMaxDepth(size_t depth) { m_maxDepth = depth; }
+
+    // Skip the bodies of functions, keeping only their signatures and source ranges
+    // Only a body that is a block is skipped, by matching its braces. Errors in it are
+    // reported when it's parsed, and if its braces don't balance, it may not end where
+    // the recovery of an eager parse would. The parser must outlive the tree.
+    void setLazyBodies(bool lazy) { m_lazy = lazy; }
+
+    // Everything about the trees this parser produces that its settings decide, for
+    // caches of trees to tell them apart
+    static constexpr uint64_t Settings(size_t maxDepth, bool lazy) { return uint64_t(maxDepth) << 1 | lazy; }
+    uint64_t settings() const { return Settings(m_maxDepth, m_lazy); }
+
+    // The body of a function of a tree this parser produced, parsing it the first time
+    Node* ParseBody(AST& ast, FunctionNode* function);
+
+    // Parse the whole source into a tree
+    // A tree too large for its region is reported, and an empty one returned instead.
     AST operator()();
+
+    // Parse the whole source into the same tree as operator(), on several threads
+    // A pre-scan cuts the tokens into chunks after ';' outside of any brackets, and
+    // threads parse the chunks into trees of their own, stealing chunks from each
+    // other when they run out. The chunks' nodes are then copied into one tree in
+    // order. Chunks are parsed speculatively: from the first one that has errors or
+    // doesn't end on its boundary, the rest is parsed sequentially, which is also the
+    // only part reporting to the diagnostics. threads = 0 uses every hardware thread.
+    // Streamed sources are parsed sequentially.
+    AST ParseParallel(size_t threads = 0, size_t minChunk = DEFAULT_MIN_CHUNK);
+
+    // Update a tree this parser's settings produced, after an edit of its source
+    // The tokens must have been updated by TokenStream::relex, which returned relexed.
+    // The smallest block around the relexed tokens is parsed again, or if there is none,
+    // or it no longer ends where it did, the top-level items from the one around them
+    // until one starts after them where an old one did. Everything else is kept as it
+    // is, with its offsets moved past the edit, and the replaced nodes stay in the tree's
+    // region until they take more of it than the tree does: the tree is compacted then,
+    // and every node moves. If the region fills up all the same, the tree is parsed
+    // from scratch into a new one. The result is the tree a full parse would produce.
+    // Only the errors in the parsed tokens are reported; their range is returned.
+    TokenRange Reparse(AST& tree, const TextEdit& edit, const TokenRange& relexed);
+
+    // Parse the top-level items one at a time, calling f(Node* item) on each as soon as
+    // the ';' after it is taken, then let go of it: the item and its nodes are only valid
+    // during the call. Items failing to parse are left out, as in a whole tree. A streamed
+    // source is parsed in memory bounded by the largest item, no matter its length.
+    template <typename F>
+    void ParseEach(F&& f);
   };
+
+  template <typename F>
+  void Parser::ParseEach(F&& f)
+  {
+    while (!eof())
+    {
+      size_t mark = m_items.size();
+      ParseItems(m_index + 1);
+      if (m_items.size() > mark)
+      {
+        f(m_items.back());
+      }
+      m_items.resize(mark);
+      m_starts.resize(mark);
+      Release();
+    }
+    Finish();
+  }
   
 } // namespace leor
 
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Parser/Parser.h"
+
+// Character literals: what each one decodes to, or what it's reported as
+namespace
+{
+
+  using namespace leor;
+
+  // The value of the character literal in source, and the codes of the diagnostics
+  struct Parsed
+  {
+    char32_t value = INVALID_CHAR;
+    std::vector<DiagCode> codes;
+  };
+
+  Parsed Parse(const std::string& source)
+  {
+    Parsed parsed;
+    Diagnostics diags;
+    Parser parser(source, 0, &diags);
+    auto ast = parser();
+    std::vector<Node*> stack{ ast.root() };
+    while (!stack.empty())
+    {
+      auto node = stack.back();
+      stack.pop_back();
+      if (auto c = node->as<CharNode>())
+      {
+        parsed.value = c->value;
+      }
+      ForEachChild(node, [&stack](RelPtr<Node>& child) { stack.push_back(child); });
+    }
+    for (auto& diag : diags.all())
+    {
+      parsed.codes.push_back(diag.code);
+    }
+    return parsed;
+  }
+
+  bool Decodes(const std::string& literal, char32_t value)
+  {
+    auto parsed = Parse("c = " + literal + ";\n");
+    return parsed.codes.empty() && parsed.value == value;
+  }
+
+  bool Reports(const std::string& literal, DiagCode code)
+  {
+    auto parsed = Parse("c = " + literal + ";\n");
+    return parsed.codes == std::vector<DiagCode>{ code };
+  }
+
+} // namespace
+
+int32_t main()
+{
+  struct Case
+  {
+    const char* name;
+    bool passed;
+  };
+  const Case cases[] = {
+    { "'a'", Decodes("'a'", 'a') },
+    { "'\\n'", Decodes("'\\n'", '\n') },
+    { "'\\xFF' is a byte", Decodes("'\\xFF'", 0xFF) },
+    { "'\\u{7F}'", Decodes("'\\u{7F}'", 0x7F) },
+    { "'\\u{E9}' is one character", Decodes("'\\u{E9}'", 0xE9) },
+    { "'\\u{20AC}'", Decodes("'\\u{20AC}'", 0x20AC) },
+    { "'\\u{1F600}'", Decodes("'\\u{1F600}'", 0x1F600) },
+    { "UTF-8 written as it is", Decodes("'\xC3\xA9'", 0xE9) },
+    { "''", Reports("''", DiagCode::EMPTY_CHARACTER) },
+    { "'ab'", Reports("'ab'", DiagCode::MULTIPLE_CHARACTERS) },
+    { "'\\u{E9}e'", Reports("'\\u{E9}e'", DiagCode::MULTIPLE_CHARACTERS) },
+    { "'\\xC3\\x28' is no UTF-8", Reports("'\\xC3\\x28'", DiagCode::MULTIPLE_CHARACTERS) },
+  };
+
+  int32_t failed = 0;
+  for (auto& c : cases)
+  {
+    std::cout << (c.passed ? "[PASS] " : "[FAIL] ") << c.name << std::endl;
+    failed += !c.passed;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Lexer/TokenStream.h"
+#include "Parser/Parser.h"
+
+// Machine-generated extremes the lexer and parser must get through in bounded stack:
+// every one of them used to recurse once per term, level or comment line
+namespace
+{
+
+  using namespace leor;
+
+  // Number of nodes of each type under root, walked on a stack of our own
+  std::vector<size_t> Census(Node* root)
+  {
+    std::vector<size_t> counts(static_cast<size_t>(Node::Type::UNARY) + 1);
+    std::vector<Node*> stack{ root };
+    while (!stack.empty())
+    {
+      auto node = stack.back();
+      stack.pop_back();
+      counts[static_cast<size_t>(node->type)]++;
+      ForEachChild(node, [&stack](RelPtr<Node>& child) { stack.push_back(child); });
+    }
+    return counts;
+  }
+
+  size_t Count(const std::vector<size_t>& counts, Node::Type type)
+  {
+    return counts[static_cast<size_t>(type)];
+  }
+
+  // The source of n terms joined by op
+  std::string Chain(size_t n, std::string_view op)
+  {
+    std::string source = "x = a";
+    for (size_t i = 1; i < n; i++)
+    {
+      source.append(" ").append(op).append(" a");
+    }
+    return source + ";\n";
+  }
+
+  // A million terms of a left associative operator: the tree is a million levels deep
+  // on its left, and cloning it must not recurse either
+  bool Sum()
+  {
+    constexpr size_t TERMS = 1000000;
+    auto source = Chain(TERMS, "+");
+    Diagnostics diags;
+    auto tokens = TokenStream::Tokenize(source, 0, &diags);
+    Parser parser(tokens, &diags);
+    auto ast = parser();
+    auto counts = Census(ast.root());
+
+    AST copy;
+    auto root = static_cast<ProgNode*>(copy.Clone(ast.root()));
+    copy.setRoot(root);
+    return diags.empty() && ast.root()->prog.size() == 1 &&
+      Count(counts, Node::Type::BINARY) == TERMS && Count(counts, Node::Type::VAR) == TERMS + 1 &&
+      Census(copy.root()) == counts;
+  }
+
+  // A million terms of a right associative operator: deep on the right instead
+  bool Assignments()
+  {
+    constexpr size_t TERMS = 1000000;
+    auto source = Chain(TERMS, "=");
+    Diagnostics diags;
+    auto tokens = TokenStream::Tokenize(source, 0, &diags);
+    Parser parser(tokens, &diags);
+    auto ast = parser();
+    auto counts = Census(ast.root());
+    return diags.empty() && ast.root()->prog.size() == 1 && Count(counts, Node::Type::VAR) == TERMS + 1;
+  }
+
+  // Nesting past the limit is one diagnostic, not a stack overflow
+  bool Parentheses()
+  {
+    constexpr size_t DEPTH = 1000000;
+    std::string source = "x = " + std::string(DEPTH, '(') + "a" + std::string(DEPTH, ')') + ";\ny = 1;\n";
+    Diagnostics diags;
+    auto tokens = TokenStream::Tokenize(source, 0, &diags);
+    Parser parser(tokens, &diags);
+    auto ast = parser();
+    return diags.size() == 1 && diags.all()[0].code == DiagCode::NESTING_TOO_DEEP;
+  }
+
+  // A hundred thousand comment lines before the only statement
+  bool Comments()
+  {
+    constexpr size_t LINES = 100000;
+    std::string source;
+    for (size_t i = 0; i < LINES; i++)
+    {
+      source += "# comment line " + std::to_string(i) + "\n";
+    }
+    source += "x = 1;\n";
+
+    Diagnostics diags;
+    Lexer lexer(source, 0, &diags);
+    size_t count = 0;
+    while (!lexer.eof())
+    {
+      lexer.get();
+      count++;
+    }
+
+    auto tokens = TokenStream::Tokenize(source, 0, &diags);
+    Parser parser(tokens, &diags);
+    auto ast = parser();
+    return diags.empty() && count == 4 && tokens.size() == 5 && ast.root()->prog.size() == 1;
+  }
+
+} // namespace
+
+int32_t main()
+{
+  struct Case
+  {
+    const char* name;
+    bool (*run)();
+  };
+  const Case cases[] = {
+    { "1,000,000-term sum", Sum },
+    { "1,000,000-term assignment chain", Assignments },
+    { "1,000,000 nested parentheses", Parentheses },
+    { "100,000 comment lines", Comments },
+  };
+
+  int32_t failed = 0;
+  for (auto& c : cases)
+  {
+    auto start = std::chrono::steady_clock::now();
+    bool passed = c.run();
+    auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << (passed ? "[PASS] " : "[FAIL] ") << c.name << " (" << static_cast<int64_t>(ms) << " ms)" << std::endl;
+    failed += !passed;
+  }
+  return failed ? 1 : 0;
+}